@@ -0,0 +1,142 @@
+// block and unblock random cells of a map with Map::setBlocked, time the incremental repairs of the distance tables
+// and check the repaired tables against the BFS of the changed map (Map::checkDistances)
+//
+// the cells are first blocked and unblocked one at a time, then several cells are kept blocked together:
+// a cell with its neighbors, a wall across a row and scattered cells, unblocked in a random order
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include "../utils/ezOptionParser.hpp"
+#include "../solver/Map.h"
+
+int main(int argc, const char *argv[]) {
+    ez::ezOptionParser optionParser;
+
+    optionParser.overview = "Runtime blocking benchmark and self-check of the distance repairs";
+    optionParser.syntax = "./MAPF-benchmark-blocking -d test-benchmark -m well-formed-21-35.map";
+
+    optionParser.add("", false, 0, 0, "Display this Message.", "-h", "--help");
+    optionParser.add("test-benchmark", false, 1, 0, "Data Path", "-d", "--data");
+    optionParser.add("well-formed-21-35.map", false, 1, 0, "Map File (Relative to Data Path/map)", "-m", "--map");
+    optionParser.add("20", false, 1, 0, "Number of cells blocked and unblocked one at a time", "-n", "--cells");
+    optionParser.add("3", false, 1, 0, "Number of rounds with several cells blocked together", "-r", "--rounds");
+    optionParser.add("8", false, 1, 0, "Number of cells blocked together in a round", "-k", "--together");
+    optionParser.add("0", false, 1, 0, "Seed of the cells", "--seed");
+    optionParser.add("", false, 0, 0, "Do not check the tables after each change", "--no-check");
+
+    optionParser.parse(argc, argv);
+
+    if (optionParser.isSet("-h")) {
+        std::string usage;
+        optionParser.getUsage(usage, 80, ez::ezOptionParser::ALIGN);
+        std::cout << usage;
+        return 1;
+    }
+
+    std::string dataPath, mapName;
+    unsigned long long cellCount, roundCount, togetherCount, seed;
+    optionParser.get("--data")->getString(dataPath);
+    optionParser.get("--map")->getString(mapName);
+    optionParser.get("--cells")->getULongLong(cellCount);
+    optionParser.get("--rounds")->getULongLong(roundCount);
+    optionParser.get("--together")->getULongLong(togetherCount);
+    optionParser.get("--seed")->getULongLong(seed);
+    bool check = !optionParser.isSet("--no-check");
+
+    Map map(dataPath + "/map/" + mapName);
+    auto isTraversable = [&map](std::pair<size_t, size_t> pos) {
+        return map.getDistanceIndex(pos) != std::numeric_limits<size_t>::max();
+    };
+    std::vector<Map::CellId> cells;
+    for (size_t i = 0; i < map.getHeight(); i++) {
+        for (size_t j = 0; j < map.getWidth(); j++) {
+            if (isTraversable({i, j})) cells.emplace_back(map.getCellId({i, j}));
+        }
+    }
+    if (cells.empty()) {
+        std::cerr << "no traversable cells in " << mapName << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 random(seed);
+    std::uniform_int_distribution<size_t> cellDistribution(0, cells.size() - 1);
+    double times[2] = {0, 0};
+    size_t counts[2] = {0, 0}, errors = 0;
+    auto change = [&](Map::CellId id, bool blocked) {
+        if (map.isBlocked(id) == blocked) return;
+        auto start = std::chrono::steady_clock::now();
+        map.setBlocked(id, blocked);
+        auto end = std::chrono::steady_clock::now();
+        times[blocked] += std::chrono::duration<double, std::milli>(end - start).count();
+        ++counts[blocked];
+        if (check) {
+            auto rows = map.checkDistances();
+            if (rows > 0) {
+                auto pos = map.getPos(id);
+                std::cerr << "cell (" << pos.first << ", " << pos.second << ") "
+                          << (blocked ? "blocked" : "unblocked") << ": " << rows << " rows differ" << std::endl;
+                errors += rows;
+            }
+        }
+    };
+    auto unblockAll = [&](std::vector<Map::CellId> &blockedCells) {
+        std::shuffle(blockedCells.begin(), blockedCells.end(), random);
+        for (auto id : blockedCells) change(id, false);
+    };
+
+    for (size_t k = 0; k < cellCount; k++) {
+        auto id = cells[cellDistribution(random)];
+        change(id, true);
+        change(id, false);
+    }
+
+    for (size_t k = 0; k < roundCount; k++) {
+        // a cell with its neighbors (adjacent blocked cells)
+        std::vector<Map::CellId> blockedCells;
+        auto center = map.getPos(cells[cellDistribution(random)]);
+        blockedCells.emplace_back(map.getCellId(center));
+        for (auto direction : Map::directions) {
+            auto next = map.getPosByDirection(center, direction);
+            if (next.first && isTraversable(next.second)) blockedCells.emplace_back(map.getCellId(next.second));
+        }
+        for (auto id : blockedCells) change(id, true);
+        unblockAll(blockedCells);
+
+        // a wall of up to togetherCount cells along a row, which closes the corridors it crosses
+        blockedCells.clear();
+        auto wall = map.getPos(cells[cellDistribution(random)]);
+        for (size_t j = wall.second; j < map.getWidth() && blockedCells.size() < togetherCount; j++) {
+            if (isTraversable({wall.first, j})) blockedCells.emplace_back(map.getCellId({wall.first, j}));
+        }
+        for (auto id : blockedCells) change(id, true);
+        unblockAll(blockedCells);
+
+        // scattered cells, blocked and unblocked in different orders while the others stay blocked
+        blockedCells.clear();
+        for (size_t i = 0; i < togetherCount; i++) {
+            auto id = cells[cellDistribution(random)];
+            if (std::find(blockedCells.begin(), blockedCells.end(), id) == blockedCells.end()) {
+                blockedCells.emplace_back(id);
+            }
+        }
+        for (auto id : blockedCells) change(id, true);
+        unblockAll(blockedCells);
+    }
+
+    std::cout << cells.size() << " traversable cells, " << counts[true] << " cells blocked, "
+              << counts[false] << " unblocked" << std::endl;
+    if (counts[true] > 0) {
+        std::cout << "block: " << times[true] / (double) counts[true] << "ms, unblock: "
+                  << times[false] / (double) counts[false] << "ms per cell" << std::endl;
+    }
+    if (check) {
+        std::cout << (errors == 0 ? "all repaired tables match the BFS" : "repaired tables differ from the BFS")
+                  << std::endl;
+    }
+    return errors == 0 ? 0 : 1;
+}
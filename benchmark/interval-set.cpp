@@ -0,0 +1,200 @@
+// compare FlatIntervalSet with boost::icl::interval_set on the reservations dumped by
+// ./MAPF ... --dump-reservations <file> (the format of Map::printOccupiedMap)
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include "../utils/ezOptionParser.hpp"
+#include "../solver/IntervalSet.h"
+
+typedef boost::icl::interval_set<size_t> BoostIntervalSet;
+
+struct Query {
+    size_t set;
+    size_t time;
+};
+
+static std::vector<std::vector<std::pair<size_t, size_t> > > readReservations(const std::string &filename) {
+    std::ifstream fin(filename);
+    if (!fin.is_open()) {
+        throw std::runtime_error("reservation file not found");
+    }
+    std::vector<std::vector<std::pair<size_t, size_t> > > result;
+    std::string line;
+    while (std::getline(fin, line)) {
+        // x y direction: {[a,b)[c,d)...}
+        auto pos = line.find(':');
+        if (pos == std::string::npos) continue;
+        std::vector<std::pair<size_t, size_t> > intervals;
+        for (auto c = line.find('[', pos); c != std::string::npos; c = line.find('[', c + 1)) {
+            size_t lower, upper;
+            char comma;
+            std::istringstream iss(line.substr(c + 1));
+            if (iss >> lower >> comma >> upper) {
+                intervals.emplace_back(lower, upper);
+            }
+        }
+        if (!intervals.empty()) result.emplace_back(std::move(intervals));
+    }
+    return result;
+}
+
+// time of the operations on all queries in ns per query, the checksum keeps the results alive
+static double measure(size_t repeat, size_t queries, const std::function<size_t()> &f, size_t &checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repeat; i++) {
+        checksum += f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (double) (repeat * queries);
+}
+
+template<typename Set>
+static std::vector<Set> build(const std::vector<std::vector<std::pair<size_t, size_t> > > &reservations) {
+    std::vector<Set> sets(reservations.size());
+    for (size_t i = 0; i < reservations.size(); i++) {
+        for (auto &interval : reservations[i]) {
+            sets[i].add(typename Set::interval_type(interval.first, interval.second));
+        }
+    }
+    return sets;
+}
+
+template<typename Set>
+static std::vector<double> run(const std::vector<std::vector<std::pair<size_t, size_t> > > &reservations,
+                               const std::vector<Query> &queries, size_t repeat, std::vector<size_t> &checksums) {
+    typedef typename Set::interval_type SetInterval;
+    std::vector<double> result;
+    checksums.assign(5, 0);
+    std::vector<Set> sets;
+
+    // build the sets from the intervals
+    size_t intervalCount = 0;
+    for (auto &intervals : reservations) intervalCount += intervals.size();
+    result.emplace_back(measure(repeat, intervalCount, [&]() {
+        sets = build<Set>(reservations);
+        return sets.size();
+    }, checksums[0]));
+
+    // isOccupied(h_v): does [t, t + 1) intersect the set
+    result.emplace_back(measure(repeat, queries.size(), [&]() {
+        size_t count = 0;
+        for (auto &query : queries) {
+            count += intersects(sets[query.set], SetInterval(query.time, query.time + 1));
+        }
+        return count;
+    }, checksums[1]));
+
+    // findNotOccupiedInterval: the free interval around t
+    result.emplace_back(measure(repeat, queries.size(), [&]() {
+        size_t sum = 0;
+        for (auto &query : queries) {
+            auto &set = sets[query.set];
+            auto it = set.upper_bound(SetInterval(query.time, query.time + 1));
+            if (it != set.end()) sum += it->lower();
+            if (it != set.begin()) sum += std::prev(it)->upper();
+        }
+        return sum;
+    }, checksums[2]));
+
+    // the last upper bound (cv in Solver::step)
+    result.emplace_back(measure(repeat, queries.size(), [&]() {
+        size_t sum = 0;
+        for (auto &query : queries) {
+            sum += lastUpper(sets[query.set]);
+        }
+        return sum;
+    }, checksums[3]));
+
+    // reserve and release [t, t + 1), as the manager does when it tries a path
+    result.emplace_back(measure(repeat, queries.size(), [&]() {
+        size_t sum = 0;
+        for (auto &query : queries) {
+            auto &set = sets[query.set];
+            if (intersects(set, SetInterval(query.time, query.time + 1))) continue;
+            set.add(SetInterval(query.time, query.time + 1));
+            sum += set.iterative_size();
+            set.subtract(SetInterval(query.time, query.time + 1));
+        }
+        return sum;
+    }, checksums[4]));
+    return result;
+}
+
+int main(int argc, const char *argv[]) {
+    ez::ezOptionParser optionParser;
+
+    optionParser.overview = "Interval set benchmark on dumped reservations";
+    optionParser.syntax = "./MAPF-benchmark-interval-set -i reservations.txt";
+
+    optionParser.add("", false, 0, 0, "Display this Message.", "-h", "--help");
+    optionParser.add("", true, 1, 0, "Reservation file (--dump-reservations of MAPF)", "-i", "--input");
+    optionParser.add("1000000", false, 1, 0, "Number of queries", "-q", "--queries");
+    optionParser.add("20", false, 1, 0, "Repeat times", "-r", "--repeat");
+
+    optionParser.parse(argc, argv);
+
+    if (optionParser.isSet("-h")) {
+        std::string usage;
+        optionParser.getUsage(usage, 80, ez::ezOptionParser::ALIGN);
+        std::cout << usage;
+        return 1;
+    }
+
+    std::string inputFile;
+    unsigned long long queryCount, repeat;
+    optionParser.get("--input")->getString(inputFile);
+    optionParser.get("--queries")->getULongLong(queryCount);
+    optionParser.get("--repeat")->getULongLong(repeat);
+
+    auto reservations = readReservations(inputFile);
+    if (reservations.empty()) {
+        std::cerr << "no reservations in " << inputFile << std::endl;
+        return 1;
+    }
+    size_t intervalCount = 0, maxTime = 0;
+    for (auto &intervals : reservations) {
+        intervalCount += intervals.size();
+        for (auto &interval : intervals) {
+            // the infinite waiting intervals end at max / 2
+            if (interval.second < std::numeric_limits<size_t>::max() / 4) {
+                maxTime = std::max(maxTime, interval.second);
+            }
+        }
+    }
+    std::cout << reservations.size() << " sets, " << intervalCount << " intervals, max time " << maxTime << std::endl;
+
+    std::mt19937_64 random(0);
+    std::uniform_int_distribution<size_t> setDistribution(0, reservations.size() - 1);
+    std::uniform_int_distribution<size_t> timeDistribution(0, maxTime + 1);
+    std::vector<Query> queries(queryCount);
+    for (auto &query : queries) {
+        query.set = setDistribution(random);
+        query.time = timeDistribution(random);
+    }
+
+    std::vector<size_t> flatChecksums, boostChecksums;
+    auto flat = run<FlatIntervalSet>(reservations, queries, repeat, flatChecksums);
+    auto boost = run<BoostIntervalSet>(reservations, queries, repeat, boostChecksums);
+
+    const char *names[] = {"build (per interval)", "isOccupied", "findNotOccupiedInterval", "lastUpper",
+                           "add + subtract"};
+    std::cout << "operation                     flat (ns)  boost::icl (ns)  speedup" << std::endl;
+    for (size_t i = 0; i < flat.size(); i++) {
+        std::ostringstream oss;
+        oss.setf(std::ios::fixed);
+        oss.precision(2);
+        oss << names[i] << std::string(30 - std::string(names[i]).size(), ' ')
+            << flat[i] << "\t" << boost[i] << "\t\t" << boost[i] / flat[i] << "x";
+        if (flatChecksums[i] != boostChecksums[i]) oss << "  (results differ)";
+        std::cout << oss.str() << std::endl;
+    }
+    return 0;
+}
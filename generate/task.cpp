@@ -43,7 +43,7 @@ int main() {
 //    std::random_device rd;
     std::mt19937 g;
 
-    Solver solver(map);
+    SolverT<SafeIntervalExpansion, PlainOrdering> solver(map);
 
     std::vector<std::pair<size_t, size_t> > availablePoints;
     for (size_t i = 0; i < map->getHeight(); i++) {
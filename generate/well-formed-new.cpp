@@ -160,7 +160,7 @@ int main(int argc, const char *argv[]) {
 
     ostringstream agentConfigs;
     ostringstream taskConfigs;
-    Solver solver(map);
+    SolverT<SafeIntervalExpansion, PlainOrdering> solver(map);
 
     vector<Agent> agents(agentNum);
     for (size_t i = 0; i < agentNum; i++) {
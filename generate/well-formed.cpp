@@ -131,7 +131,7 @@ int main(int argc, const char *argv[]) {
 
     ostringstream agentConfigs;
     ostringstream taskConfigs;
-    Solver solver(map);
+    SolverT<SafeIntervalExpansion, PlainOrdering> solver(map);
 
     for (size_t i = 0; i < agentNum; i++) {
         auto firstPoint = parkingPoints.back();
@@ -0,0 +1,112 @@
+#include "AgentBounds.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAPF_AGENT_BOUNDS_AVX2
+
+#include <immintrin.h>
+
+#endif
+
+constexpr uint32_t AgentBounds::INFINITE;
+
+namespace {
+
+    // a + b saturated at the max
+    inline uint32_t addSaturated(uint32_t a, uint32_t b) {
+        return a + std::min(b, ~a);
+    }
+
+    void computeScalar(const uint32_t *timestamps, const uint32_t *distances, uint32_t taskDistance,
+                       uint32_t *bounds, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            bounds[k] = addSaturated(addSaturated(timestamps[k], distances[k]), taskDistance);
+        }
+    }
+
+    void getCandidatesScalar(const uint32_t *bounds, uint32_t threshold, std::vector<uint32_t> &candidates,
+                             size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            if (bounds[k] <= threshold) candidates.push_back((uint32_t) k);
+        }
+    }
+
+#ifdef MAPF_AGENT_BOUNDS_AVX2
+
+    bool hasAvx2() {
+        static const bool flag = __builtin_cpu_supports("avx2");
+        return flag;
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256i addSaturated(__m256i a, __m256i b) {
+        auto notA = _mm256_xor_si256(a, _mm256_set1_epi32(-1));
+        return _mm256_add_epi32(a, _mm256_min_epu32(b, notA));
+    }
+
+    // return the number of agents done, the rest is left to the scalar version
+    __attribute__((target("avx2")))
+    size_t computeAvx2(const uint32_t *timestamps, const uint32_t *distances, uint32_t taskDistance,
+                       uint32_t *bounds, size_t size) {
+        auto task = _mm256_set1_epi32((int) taskDistance);
+        size_t k = 0;
+        for (; k + 8 <= size; k += 8) {
+            auto t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(timestamps + k));
+            auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(distances + k));
+            auto bound = addSaturated(addSaturated(t, d), task);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(bounds + k), bound);
+        }
+        return k;
+    }
+
+    __attribute__((target("avx2")))
+    size_t getCandidatesAvx2(const uint32_t *bounds, uint32_t threshold, std::vector<uint32_t> &candidates,
+                             size_t size) {
+        // bound <= threshold <=> max(bound, threshold) == threshold
+        auto limit = _mm256_set1_epi32((int) threshold);
+        size_t k = 0;
+        for (; k + 8 <= size; k += 8) {
+            auto bound = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bounds + k));
+            auto mask = _mm256_cmpeq_epi32(_mm256_max_epu32(bound, limit), limit);
+            auto bits = (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+            while (bits) {
+                candidates.push_back((uint32_t) (k + __builtin_ctz(bits)));
+                bits &= bits - 1;
+            }
+        }
+        return k;
+    }
+
+#endif
+
+}
+
+void AgentBounds::resize(size_t size) {
+    positions.resize(size);
+    timestamps.resize(size);
+    distances.resize(size);
+    bounds.resize(size);
+}
+
+void AgentBounds::compute(size_t taskDistance) {
+    size_t k = 0;
+#ifdef MAPF_AGENT_BOUNDS_AVX2
+    if (hasAvx2()) {
+        k = computeAvx2(timestamps.data(), distances.data(), saturate(taskDistance), bounds.data(), size());
+    }
+#endif
+    computeScalar(timestamps.data(), distances.data(), saturate(taskDistance), bounds.data(), k, size());
+}
+
+const std::vector<uint32_t> &AgentBounds::getCandidates(size_t upperBound) {
+    candidates.clear();
+    size_t k = 0;
+#ifdef MAPF_AGENT_BOUNDS_AVX2
+    if (hasAvx2()) {
+        k = getCandidatesAvx2(bounds.data(), getThreshold(upperBound), candidates, size());
+    }
+#endif
+    getCandidatesScalar(bounds.data(), getThreshold(upperBound), candidates, k, size());
+    return candidates;
+}
@@ -0,0 +1,61 @@
+#ifndef MAPF_AGENTBOUNDS_H
+#define MAPF_AGENTBOUNDS_H
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+
+// Lower bounds of the time the agents can finish a task (lastTimeStamp + d(pos, start) + d(start, end)),
+// see Manager::computeAgentForTask
+//
+// the positions, timestamps and distances of the agents are kept in structure-of-arrays form, so that the bounds
+// and the comparisons with the upper bound run on 8 agents at once (AVX2 if the cpu supports it, scalar otherwise),
+// the values are uint32_t saturated at INFINITE, so an agent that can not reach the task is pruned by any upper bound
+class AgentBounds {
+public:
+    static constexpr uint32_t INFINITE = std::numeric_limits<uint32_t>::max();
+
+private:
+    std::vector<uint32_t> positions;    // cell ids
+    std::vector<uint32_t> timestamps, distances, bounds;
+    std::vector<uint32_t> candidates;
+
+    static uint32_t saturate(size_t value) { return value < INFINITE ? (uint32_t) value : INFINITE; };
+
+    // the largest bound that is not pruned by the upper bound
+    static uint32_t getThreshold(size_t upperBound) {
+        return upperBound < INFINITE ? (uint32_t) upperBound : INFINITE - 1;
+    };
+
+public:
+    // the agents are indexed by their order in the current pass
+    void resize(size_t size);
+
+    size_t size() const { return timestamps.size(); };
+
+    void setAgent(size_t k, uint32_t pos, size_t timestamp) {
+        positions[k] = pos;
+        timestamps[k] = saturate(timestamp);
+    };
+
+    auto &getPositions() const { return this->positions; };
+
+    // the distances from the agents to the task start (filled by Map::getGraphDistancesEndpoint)
+    uint32_t *getDistances() { return distances.data(); };
+
+    void setDistance(size_t k, size_t distance) { distances[k] = saturate(distance); };
+
+    // bounds = timestamps + distances + taskDistance (the distance from the task start to the task end)
+    void compute(size_t taskDistance);
+
+    size_t getBound(size_t k) const { return bounds[k]; };
+
+    bool isPruned(size_t k, size_t upperBound) const { return bounds[k] > getThreshold(upperBound); };
+
+    // the agents whose bounds are not pruned by the upper bound, in increasing order
+    const std::vector<uint32_t> &getCandidates(size_t upperBound);
+};
+
+
+#endif //MAPF_AGENTBOUNDS_H
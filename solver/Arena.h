@@ -0,0 +1,89 @@
+#ifndef MAPF_ARENA_H
+#define MAPF_ARENA_H
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+// Slab allocator of the objects of one type that are released all at once
+// objects are bump-allocated from slabs of SLAB_SIZE objects, a destroyed object is put on a free list
+// and reused by the next create, reset releases everything but keeps the slabs for the next round,
+// so the heap is only used when a round needs more objects than any round before
+template<typename T>
+class Arena {
+    static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destructed");
+
+public:
+    static constexpr size_t SLAB_SIZE = 4096;
+
+    struct Stats {
+        size_t objects = 0;     // created objects
+        size_t reused = 0;      // created from the free list
+        size_t slabs = 0;       // allocated slabs (the only heap allocations of the arena)
+        size_t resets = 0;
+    };
+
+private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]> > slabs;
+    size_t slab = 0, offset = 0;    // the next slot to bump-allocate
+    Slot *freeList = nullptr;
+    Stats stats;
+
+    Slot *allocate() {
+        if (freeList) {
+            auto slot = freeList;
+            freeList = slot->next;
+            ++stats.reused;
+            return slot;
+        }
+        if (offset == SLAB_SIZE) {
+            ++slab;
+            offset = 0;
+        }
+        if (slab == slabs.size()) {
+            slabs.emplace_back(new Slot[SLAB_SIZE]);
+            ++stats.slabs;
+        }
+        return &slabs[slab][offset++];
+    };
+
+public:
+    Arena() = default;
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    template<typename... Args>
+    T *create(Args &&... args) {
+        ++stats.objects;
+        return new(allocate()->storage) T{std::forward<Args>(args)...};
+    };
+
+    // the object can be reused by the next create
+    void destroy(T *object) {
+        auto slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+    };
+
+    // release all objects, the slabs are kept
+    void reset() {
+        slab = 0;
+        offset = 0;
+        freeList = nullptr;
+        ++stats.resets;
+    };
+
+    auto &getStats() const { return this->stats; };
+};
+
+
+#endif //MAPF_ARENA_H
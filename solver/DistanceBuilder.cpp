@@ -0,0 +1,153 @@
+#include "DistanceBuilder.h"
+
+#include <charconv>
+#include <string>
+
+DistanceBuilder::DistanceBuilder(const std::vector<std::vector<char> > &map) {
+    height = map.size();
+    width = height > 0 ? map[0].size() : 0;
+    stride = width + 2;
+    grid.assign((height + 2) * stride, '@');
+    for (size_t i = 0; i < height; i++) {
+        for (size_t j = 0; j < width; j++) {
+            grid[(i + 1) * stride + j + 1] = map[i][j];
+        }
+    }
+    initOffsets();
+}
+
+DistanceBuilder::DistanceBuilder(size_t height, size_t width, std::vector<char> grid)
+        : height(height), width(width), stride(width + 2), grid(std::move(grid)) {
+    initOffsets();
+}
+
+void DistanceBuilder::initOffsets() {
+    // UP, RIGHT, DOWN, LEFT
+    offsets[0] = -(int) stride;
+    offsets[1] = 1;
+    offsets[2] = (int) stride;
+    offsets[3] = -1;
+}
+
+uint32_t DistanceBuilder::getEndpointDistance(const uint32_t *row, size_t id) const {
+    uint32_t result = INFINITE_DISTANCE;
+    for (auto offset : offsets) {
+        size_t next = id + offset;
+        if (grid[next] != '.') continue;
+        uint32_t distance = row[next];
+        if (distance != INFINITE_DISTANCE && distance + 1 < result) {
+            result = distance + 1;
+        }
+    }
+    return result;
+}
+
+void DistanceBuilder::computeRow(size_t source, bool endpoint, uint32_t *row, std::vector<uint32_t> &queue) const {
+    // the BFS runs on the padded grid, the result is copied to the row without the border
+    thread_local std::vector<uint32_t> padded;
+    padded.assign(grid.size(), INFINITE_DISTANCE);
+    queue.clear();
+    size_t sourceId = (source / width + 1) * stride + source % width + 1;
+    char c = grid[sourceId];
+    if (c == '@') {
+        std::fill(row, row + size(), INFINITE_DISTANCE);
+        row[source] = 0;
+        return;
+    }
+    if (endpoint && c == 't') {
+        // a 't' cell can only leave to an adjacent '.' cell
+        for (auto offset : offsets) {
+            size_t next = sourceId + offset;
+            if (grid[next] != '.') continue;
+            padded[next] = 1;
+            queue.emplace_back(next);
+        }
+    } else {
+        padded[sourceId] = 0;
+        queue.emplace_back(sourceId);
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        size_t id = queue[head];
+        uint32_t distance = padded[id] + 1;
+        for (auto offset : offsets) {
+            size_t next = id + offset;
+            if (padded[next] != INFINITE_DISTANCE || !isTraversable(next, endpoint)) continue;
+            padded[next] = distance;
+            queue.emplace_back(next);
+        }
+    }
+
+    if (endpoint) {
+        // 't' cells are only reachable as the end of a path
+        for (size_t id = stride; id < grid.size() - stride; id++) {
+            if (id != sourceId && grid[id] == 't') {
+                padded[id] = getEndpointDistance(padded.data(), id);
+            }
+        }
+        padded[sourceId] = 0;
+    }
+
+    for (size_t i = 0; i < height; i++) {
+        std::copy_n(padded.data() + (i + 1) * stride + 1, width, row + i * width);
+    }
+}
+
+void DistanceBuilder::build(bool endpoint, const std::vector<size_t> &cells, DistanceTable &table,
+                            ThreadPool &pool) const {
+    std::vector<std::vector<uint32_t> > rows(pool.size() + 1, std::vector<uint32_t>(size()));
+    std::vector<std::vector<uint32_t> > denseRows(pool.size() + 1, std::vector<uint32_t>(cells.size()));
+    std::vector<std::vector<uint32_t> > queues(pool.size() + 1);
+    pool.parallelFor(0, cells.size(), 16, [&, this](size_t i) {
+        auto index = pool.getWorkerIndex();
+        auto &row = rows[index];
+        auto &denseRow = denseRows[index];
+        computeRow(cells[i], endpoint, row.data(), queues[index]);
+        for (size_t j = 0; j < cells.size(); j++) {
+            denseRow[j] = row[cells[j]];
+        }
+        table.setRow(i, denseRow.data());
+    });
+}
+
+static char *appendNumber(char *p, size_t value) {
+    return std::to_chars(p, p + 20, value).ptr;
+}
+
+void DistanceBuilder::write(std::ostream &os, bool endpoint, ThreadPool &pool) const {
+    const size_t blockSize = 64 * (pool.size() + 1);
+    std::vector<std::vector<uint32_t> > rows(pool.size() + 1, std::vector<uint32_t>(size()));
+    std::vector<std::vector<uint32_t> > queues(pool.size() + 1);
+    std::vector<std::string> texts(blockSize);
+
+    for (size_t begin = 0; begin < size(); begin += blockSize) {
+        size_t end = std::min(size(), begin + blockSize);
+        pool.parallelFor(begin, end, 4, [&, this](size_t source) {
+            auto index = pool.getWorkerIndex();
+            auto row = rows[index].data();
+            computeRow(source, endpoint, row, queues[index]);
+            auto &text = texts[source - begin];
+            text.clear();
+            char buffer[128];
+            size_t x1 = source / width, y1 = source % width;
+            for (size_t target = 0; target < size(); target++) {
+                if (row[target] == INFINITE_DISTANCE) continue;
+                char *p = appendNumber(buffer, x1);
+                *p++ = ' ';
+                p = appendNumber(p, y1);
+                *p++ = ' ';
+                p = appendNumber(p, target / width);
+                *p++ = ' ';
+                p = appendNumber(p, target % width);
+                *p++ = ' ';
+                p = appendNumber(p, row[target]);
+                *p++ = '\n';
+                text.append(buffer, p);
+            }
+        });
+        for (size_t source = begin; source < end; source++) {
+            os << texts[source - begin];
+        }
+    }
+    os.flush();
+}
@@ -0,0 +1,65 @@
+#ifndef MAPF_DISTANCEBUILDER_H
+#define MAPF_DISTANCEBUILDER_H
+
+#include "ThreadPool.h"
+#include "DistanceTable.h"
+
+#include <vector>
+#include <ostream>
+#include <limits>
+#include <cstdint>
+
+// Build the all-pairs graph distances of a grid map with one BFS per source cell
+// the result is the same as a Floyd-Warshall on the 4-connected grid, but O(V^2) instead of O(V^3)
+//
+// plain distances: all cells except '@' are traversable
+// endpoint distances: 't' cells can only be the start or the end of a path,
+//                     they are entered from or left to an adjacent '.' cell
+class DistanceBuilder {
+public:
+    static constexpr uint32_t INFINITE_DISTANCE = std::numeric_limits<uint32_t>::max();
+
+private:
+    size_t height, width, stride;
+    std::vector<char> grid;     // (height + 2) x stride, with a border of '@' so that neighbors need no bounds checks
+    int offsets[4];
+
+    bool isTraversable(size_t id, bool endpoint) const {
+        return grid[id] != '@' && (!endpoint || grid[id] != 't');
+    };
+
+    // relax the cells around a 't' cell (only '.' neighbors can be used)
+    uint32_t getEndpointDistance(const uint32_t *row, size_t id) const;
+
+    void initOffsets();
+
+public:
+    explicit DistanceBuilder(const std::vector<std::vector<char> > &map);
+
+    // grid is padded in the same way as Map
+    DistanceBuilder(size_t height, size_t width, std::vector<char> grid);
+
+    auto getHeight() const { return this->height; };
+
+    auto getWidth() const { return this->width; };
+
+    auto size() const { return this->height * this->width; };
+
+    // change a cell of the padded grid (e.g. block it with '@'), the rows computed later use the new grid
+    void setCell(size_t id, char c) { grid[id] = c; };
+
+    // compute the distances from source to all cells into row (size() entries)
+    // queue is a scratch buffer so that it can be reused by the caller
+    void computeRow(size_t source, bool endpoint, uint32_t *row, std::vector<uint32_t> &queue) const;
+
+    // compute the distances between the given cells into a wide table (cells.size() x cells.size()),
+    // row i and column j of the table are cells[i] and cells[j]
+    void build(bool endpoint, const std::vector<size_t> &cells, DistanceTable &table, ThreadPool &pool) const;
+
+    // write the table in the text format "x1 y1 x2 y2 distance" (unreachable pairs are omitted),
+    // rows are computed and formatted in blocks so that the full table is never stored
+    void write(std::ostream &os, bool endpoint, ThreadPool &pool) const;
+};
+
+
+#endif //MAPF_DISTANCEBUILDER_H
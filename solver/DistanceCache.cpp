@@ -0,0 +1,121 @@
+#include "DistanceCache.h"
+#include "DistanceTable.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+DistanceCache::DistanceCache(const DistanceBuilder &builder, const std::vector<size_t> &cells,
+                             bool endpoint, size_t budget)
+        : builder(builder), cells(cells), endpoint(endpoint) {
+    size_t rowSize = std::max<size_t>(cells.size(), 1) * sizeof(uint32_t);
+    capacity = std::max<size_t>(budget / rowSize, 1);
+}
+
+void DistanceCache::computeRow(size_t target, std::vector<uint32_t> &distances,
+                               std::vector<uint32_t> &row, std::vector<uint32_t> &queue) const {
+    row.resize(builder.size());
+    builder.computeRow(cells[target], endpoint, row.data(), queue);
+    distances.resize(cells.size());
+    for (size_t i = 0; i < cells.size(); i++) {
+        distances[i] = row[cells[i]];
+    }
+}
+
+const std::shared_ptr<const std::vector<uint32_t> > &
+DistanceCache::insert(size_t target, std::vector<uint32_t> &distances) {
+    auto it = index.find(target);
+    if (it != index.end()) {
+        // computed by another thread in the meantime
+        rows.splice(rows.begin(), rows, it->second);
+        return it->second->distances;
+    }
+    auto row = std::make_shared<const std::vector<uint32_t> >(std::move(distances));
+    if (rows.size() >= capacity) {
+        // reuse the entry of the least recently used row (the row itself is freed when it is not held)
+        auto last = std::prev(rows.end());
+        index.erase(last->target);
+        last->target = target;
+        last->distances = std::move(row);
+        rows.splice(rows.begin(), rows, last);
+        ++stats.evictions;
+    } else {
+        rows.emplace_front(Row{target, std::move(row)});
+    }
+    index.emplace(target, rows.begin());
+    return rows.front().distances;
+}
+
+size_t DistanceCache::get(size_t source, size_t target) {
+    uint32_t distance;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(target);
+        if (it != index.end()) {
+            ++stats.hits;
+            rows.splice(rows.begin(), rows, it->second);
+            distance = (*it->second->distances)[source];
+            return distance == DistanceBuilder::INFINITE_DISTANCE ? DistanceTable::INFINITE_DISTANCE : distance;
+        }
+        ++stats.misses;
+    }
+
+    // run the BFS without the lock so that other threads are not blocked
+    thread_local std::vector<uint32_t> row, queue;
+    std::vector<uint32_t> distances;
+    computeRow(target, distances, row, queue);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        distance = (*insert(target, distances))[source];
+    }
+    return distance == DistanceBuilder::INFINITE_DISTANCE ? DistanceTable::INFINITE_DISTANCE : distance;
+}
+
+std::shared_ptr<const std::vector<uint32_t> > DistanceCache::getRow(size_t target) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(target);
+        if (it != index.end()) {
+            ++stats.hits;
+            rows.splice(rows.begin(), rows, it->second);
+            return it->second->distances;
+        }
+        ++stats.misses;
+    }
+
+    thread_local std::vector<uint32_t> row, queue;
+    std::vector<uint32_t> computed;
+    computeRow(target, computed, row, queue);
+    std::lock_guard<std::mutex> lock(mutex);
+    return insert(target, computed);
+}
+
+void DistanceCache::prewarm(const std::vector<size_t> &targets, ThreadPool &pool) {
+    std::vector<size_t> uniqueTargets;
+    std::unordered_set<size_t> visited;
+    for (auto target : targets) {
+        if (uniqueTargets.size() >= capacity) break;
+        if (visited.insert(target).second) {
+            uniqueTargets.emplace_back(target);
+        }
+    }
+
+    std::vector<std::vector<uint32_t> > rowBuffers(pool.size() + 1), queues(pool.size() + 1);
+    pool.parallelFor(0, uniqueTargets.size(), 1, [&, this](size_t i) {
+        auto workerIndex = pool.getWorkerIndex();
+        std::vector<uint32_t> distances;
+        computeRow(uniqueTargets[i], distances, rowBuffers[workerIndex], queues[workerIndex]);
+        std::lock_guard<std::mutex> lock(mutex);
+        insert(uniqueTargets[i], distances);
+    });
+}
+
+void DistanceCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    rows.clear();
+    index.clear();
+}
+
+DistanceCache::Stats DistanceCache::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
@@ -0,0 +1,70 @@
+#ifndef MAPF_DISTANCECACHE_H
+#define MAPF_DISTANCECACHE_H
+
+#include "DistanceBuilder.h"
+#include "ThreadPool.h"
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+// Graph distances computed on demand, for maps too large for an all-pairs table
+// the BFS row of a target is computed the first time it is asked, rows are kept in an LRU cache
+// bounded by a memory budget, the graph is undirected so a row of the target gives the distances from all sources
+//
+// rows and columns are indices of the traversable cells (same as DistanceTable), it is safe to use from multiple threads
+// a row handed out by getRow is shared, it stays valid while it is held (after it is evicted, only the holders keep it)
+class DistanceCache {
+public:
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+    };
+
+private:
+    struct Row {
+        size_t target;
+        std::shared_ptr<const std::vector<uint32_t> > distances;
+    };
+
+    const DistanceBuilder &builder;
+    const std::vector<size_t> &cells;
+    bool endpoint;
+    size_t capacity;
+
+    std::mutex mutex;
+    std::list<Row> rows;    // most recently used first
+    std::unordered_map<size_t, std::list<Row>::iterator> index;
+    Stats stats;
+
+    // compute the row of target into distances (cells.size() entries)
+    void computeRow(size_t target, std::vector<uint32_t> &distances,
+                    std::vector<uint32_t> &row, std::vector<uint32_t> &queue) const;
+
+    // insert a computed row, return the cached row
+    const std::shared_ptr<const std::vector<uint32_t> > &insert(size_t target, std::vector<uint32_t> &distances);
+
+public:
+    DistanceCache(const DistanceBuilder &builder, const std::vector<size_t> &cells, bool endpoint, size_t budget);
+
+    // distance between two traversable cells, DistanceTable::INFINITE_DISTANCE if unreachable
+    size_t get(size_t source, size_t target);
+
+    // the row of target (distances from all traversable cells)
+    std::shared_ptr<const std::vector<uint32_t> > getRow(size_t target);
+
+    // compute the rows of the targets in parallel (at most the capacity of the cache)
+    void prewarm(const std::vector<size_t> &targets, ThreadPool &pool);
+
+    void clear();
+
+    auto getCapacity() const { return this->capacity; };
+
+    Stats getStats();
+};
+
+
+#endif //MAPF_DISTANCECACHE_H
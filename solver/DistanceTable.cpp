@@ -0,0 +1,174 @@
+#include "DistanceTable.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr char DistanceTable::MAGIC[8];
+
+DistanceTable::~DistanceTable() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+DistanceTable::Header DistanceTable::createHeader(uint64_t mapHash, size_t height, size_t width, size_t cellCount) {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.mapHash = mapHash;
+    header.height = height;
+    header.width = width;
+    header.cellCount = cellCount;
+    return header;
+}
+
+void DistanceTable::allocate(size_t _cellCount, size_t _entryWidth) {
+    cellCount = _cellCount;
+    entryWidth = _entryWidth;
+    size_t size = cellCount * cellCount * entryWidth;
+    buffer.reset(new unsigned char[std::max<size_t>(size, 1)]);
+    // all bytes 0xff is the unreachable value for both entry types
+    std::memset(buffer.get(), 0xff, size);
+    data = buffer.get();
+}
+
+std::unique_ptr<DistanceTable> DistanceTable::create(size_t cellCount, bool wide) {
+    std::unique_ptr<DistanceTable> table(new DistanceTable());
+    table->allocate(cellCount, wide ? sizeof(uint32_t) : sizeof(uint16_t));
+    return table;
+}
+
+std::unique_ptr<DistanceTable> DistanceTable::open(const std::string &filename, const Header &header) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat st{};
+    Header fileHeader{};
+    if (fstat(fd, &st) != 0 || pread(fd, &fileHeader, sizeof(Header), 0) != sizeof(Header) ||
+        std::memcmp(fileHeader.magic, header.magic, sizeof(MAGIC)) != 0 ||
+        fileHeader.version != header.version || fileHeader.mapHash != header.mapHash ||
+        fileHeader.height != header.height || fileHeader.width != header.width ||
+        fileHeader.cellCount != header.cellCount ||
+        (fileHeader.entryWidth != sizeof(uint16_t) && fileHeader.entryWidth != sizeof(uint32_t))) {
+        ::close(fd);
+        return nullptr;
+    }
+    size_t expectedSize = sizeof(Header) + (size_t) header.cellCount * header.cellCount * fileHeader.entryWidth;
+    if ((size_t) st.st_size != expectedSize) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *mapping = mmap(nullptr, expectedSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return nullptr;
+    // rows are accessed randomly, only fault in the pages of the rows in use
+    madvise(mapping, expectedSize, MADV_RANDOM);
+
+    std::unique_ptr<DistanceTable> table(new DistanceTable());
+    table->mapping = mapping;
+    table->mappingSize = expectedSize;
+    table->cellCount = header.cellCount;
+    table->entryWidth = fileHeader.entryWidth;
+    table->data = static_cast<const char *>(mapping) + sizeof(Header);
+    return table;
+}
+
+bool DistanceTable::write(const std::string &filename, Header header) const {
+    // write to a temporary file first so that concurrent runs never see a partial table
+    auto tempFilename = filename + ".tmp." + std::to_string(getpid());
+    std::ofstream fout(tempFilename, std::ios::binary);
+    if (!fout.is_open()) return false;
+
+    header.entryWidth = entryWidth;
+    header.cellCount = cellCount;
+    fout.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    fout.write(static_cast<const char *>(data), getMemoryUsage());
+    fout.close();
+    if (!fout || std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+void DistanceTable::makeWritable() {
+    if (buffer) return;
+    size_t size = cellCount * cellCount * entryWidth;
+    std::unique_ptr<unsigned char[]> ownedBuffer(new unsigned char[std::max<size_t>(size, 1)]);
+    std::memcpy(ownedBuffer.get(), data, size);
+    buffer.swap(ownedBuffer);
+    data = buffer.get();
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+void DistanceTable::compact() {
+    if (!buffer || entryWidth == sizeof(uint16_t)) return;
+    auto wide = reinterpret_cast<const uint32_t *>(buffer.get());
+    size_t size = cellCount * cellCount;
+    for (size_t i = 0; i < size; i++) {
+        if (wide[i] != std::numeric_limits<uint32_t>::max() && wide[i] >= std::numeric_limits<uint16_t>::max()) {
+            return;
+        }
+    }
+    std::unique_ptr<unsigned char[]> narrowBuffer(new unsigned char[std::max<size_t>(size * sizeof(uint16_t), 1)]);
+    auto narrow = reinterpret_cast<uint16_t *>(narrowBuffer.get());
+    for (size_t i = 0; i < size; i++) {
+        narrow[i] = wide[i] == std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint16_t>::max() : wide[i];
+    }
+    buffer.swap(narrowBuffer);
+    entryWidth = sizeof(uint16_t);
+    data = buffer.get();
+}
+
+void DistanceTable::set(size_t a, size_t b, size_t distance) {
+    if (!buffer) {
+        throw std::runtime_error("distance table is read-only");
+    }
+    if (distance >= INFINITE_DISTANCE) {
+        distance = std::numeric_limits<uint32_t>::max();
+    } else if (distance >= std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("distance table entry overflow");
+    }
+    if (entryWidth == sizeof(uint16_t) && distance != std::numeric_limits<uint32_t>::max() &&
+        distance >= std::numeric_limits<uint16_t>::max()) {
+        // widen the table to uint32_t entries
+        size_t size = cellCount * cellCount;
+        auto narrow = reinterpret_cast<const uint16_t *>(buffer.get());
+        std::unique_ptr<unsigned char[]> wideBuffer(new unsigned char[size * sizeof(uint32_t)]);
+        auto wide = reinterpret_cast<uint32_t *>(wideBuffer.get());
+        for (size_t i = 0; i < size; i++) {
+            wide[i] = narrow[i] == std::numeric_limits<uint16_t>::max() ? std::numeric_limits<uint32_t>::max() : narrow[i];
+        }
+        buffer.swap(wideBuffer);
+        entryWidth = sizeof(uint32_t);
+        data = buffer.get();
+    }
+    size_t index = a * cellCount + b;
+    if (entryWidth == sizeof(uint16_t)) {
+        auto value = distance == std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint16_t>::max() : distance;
+        reinterpret_cast<uint16_t *>(buffer.get())[index] = value;
+    } else {
+        reinterpret_cast<uint32_t *>(buffer.get())[index] = distance;
+    }
+}
+
+void DistanceTable::setRow(size_t a, const uint32_t *row) {
+    if (!buffer || entryWidth != sizeof(uint32_t)) {
+        throw std::runtime_error("distance table is not writable by rows");
+    }
+    std::memcpy(buffer.get() + a * cellCount * entryWidth, row, cellCount * entryWidth);
+}
@@ -0,0 +1,105 @@
+#ifndef MAPF_DISTANCETABLE_H
+#define MAPF_DISTANCETABLE_H
+
+#include <string>
+#include <memory>
+#include <limits>
+#include <cstdint>
+
+// A compact all-pairs distance table over the traversable cells of a map
+// entries are uint16_t (uint32_t if a distance does not fit), stored in one contiguous row-major buffer,
+// which is either owned or memory-mapped read-only from a binary file
+//
+// file layout (little endian):
+//   Header
+//   cellCount x cellCount entries of entryWidth bytes, row-major
+// rows and columns are the traversable (non '@') cells of the map in row-major order,
+// unreachable pairs are stored as the maximum value of the entry type
+class DistanceTable {
+public:
+    static constexpr char MAGIC[8] = {'M', 'A', 'P', 'F', 'D', 'I', 'S', 'T'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entryWidth;    // bytes per entry
+        uint64_t mapHash;
+        uint32_t height;
+        uint32_t width;
+        uint32_t cellCount;     // traversable cells, the size of a row
+        uint32_t reserved;
+        uint64_t padding[3];
+    };
+
+    static_assert(sizeof(Header) == 64, "distance table header should be 64 bytes");
+
+    static constexpr size_t INFINITE_DISTANCE = std::numeric_limits<size_t>::max() / 2;
+
+private:
+    const void *data = nullptr;
+    size_t cellCount = 0;
+    size_t entryWidth = 0;
+    std::unique_ptr<unsigned char[]> buffer;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+
+    DistanceTable() = default;
+
+    void allocate(size_t cellCount, size_t entryWidth);
+
+public:
+    ~DistanceTable();
+
+    DistanceTable(const DistanceTable &) = delete;
+
+    DistanceTable &operator=(const DistanceTable &) = delete;
+
+    static Header createHeader(uint64_t mapHash, size_t height, size_t width, size_t cellCount);
+
+    // create an owned table with all pairs unreachable, wide tables use uint32_t entries
+    static std::unique_ptr<DistanceTable> create(size_t cellCount, bool wide = false);
+
+    // map the binary file, return nullptr if it does not exist or does not match the header
+    static std::unique_ptr<DistanceTable> open(const std::string &filename, const Header &header);
+
+    // write the binary file (atomically replaced), return false if it can not be written
+    bool write(const std::string &filename, Header header) const;
+
+    // copy a mapped table into an owned buffer so that it can be changed (the file is not changed)
+    void makeWritable();
+
+    // switch an owned wide table to uint16_t entries if all distances fit
+    void compact();
+
+    auto size() const { return this->cellCount; };
+
+    auto getEntryWidth() const { return this->entryWidth; };
+
+    auto isMapped() const { return this->mapping != nullptr; };
+
+    size_t getMemoryUsage() const { return cellCount * cellCount * entryWidth; };
+
+    size_t get(size_t a, size_t b) const {
+        size_t index = a * cellCount + b;
+        if (entryWidth == sizeof(uint16_t)) {
+            auto distance = static_cast<const uint16_t *>(data)[index];
+            if (distance == std::numeric_limits<uint16_t>::max()) return INFINITE_DISTANCE;
+            return distance;
+        } else {
+            auto distance = static_cast<const uint32_t *>(data)[index];
+            if (distance == std::numeric_limits<uint32_t>::max()) return INFINITE_DISTANCE;
+            return distance;
+        }
+    };
+
+    // only for owned tables, a distance that does not fit into uint16_t widens the table
+    void set(size_t a, size_t b, size_t distance);
+
+    // set a full row of an owned table from uint32_t distances (UINT32_MAX as unreachable),
+    // the table must be wide enough, so it can be called from multiple threads on different rows
+    void setRow(size_t a, const uint32_t *row);
+};
+
+
+#endif //MAPF_DISTANCETABLE_H
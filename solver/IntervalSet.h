@@ -0,0 +1,284 @@
+#ifndef MAPF_INTERVALSET_H
+#define MAPF_INTERVALSET_H
+
+#include <ostream>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <boost/icl/discrete_interval.hpp>
+#include <boost/icl/interval_set.hpp>
+
+// Sorted, disjoint right-open time intervals [lower, upper) stored in a small vector,
+// the reservations of a cell are usually a few intervals, so they are kept inline without any allocation
+// the interface is the subset of boost::icl::interval_set<size_t> used by the solver
+// (touching intervals are joined in the same way), so the two are interchangeable
+class FlatIntervalSet {
+public:
+    class Interval {
+    private:
+        size_t _lower, _upper;
+
+    public:
+        Interval(size_t lower, size_t upper) : _lower(lower), _upper(upper) {}
+
+        size_t lower() const { return this->_lower; };
+
+        size_t upper() const { return this->_upper; };
+
+        friend std::ostream &operator<<(std::ostream &os, const Interval &interval) {
+            return os << "[" << interval._lower << "," << interval._upper << ")";
+        }
+    };
+
+    typedef Interval interval_type;
+    typedef const Interval *const_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    static constexpr uint32_t INLINE_CAPACITY = 4;
+
+private:
+    // linear search is faster than binary search on a few intervals
+    static constexpr uint32_t LINEAR_SEARCH_SIZE = 8;
+
+    Interval *data;
+    uint32_t count = 0, capacity = INLINE_CAPACITY;
+    // raw storage so that Interval needs no default constructor
+    alignas(Interval) unsigned char inlineStorage[INLINE_CAPACITY * sizeof(Interval)];
+
+    Interval *getInlineData() { return reinterpret_cast<Interval *>(inlineStorage); };
+
+    bool isInline() const { return data == reinterpret_cast<const Interval *>(inlineStorage); };
+
+    void release() {
+        if (!isInline()) ::operator delete(data);
+    };
+
+    void reserve(uint32_t size) {
+        if (size <= capacity) return;
+        auto newCapacity = std::max(size, capacity * 2);
+        auto newData = static_cast<Interval *>(::operator new(newCapacity * sizeof(Interval)));
+        std::memcpy(static_cast<void *>(newData), data, count * sizeof(Interval));
+        release();
+        data = newData;
+        capacity = newCapacity;
+    };
+
+    // take the intervals of that (this is empty with the inline storage), that is left empty
+    void moveFrom(FlatIntervalSet &that) {
+        if (that.isInline()) {
+            std::memcpy(static_cast<void *>(data), that.data, that.count * sizeof(Interval));
+        } else {
+            data = that.data;
+            capacity = that.capacity;
+            that.data = that.getInlineData();
+            that.capacity = INLINE_CAPACITY;
+        }
+        count = that.count;
+        that.count = 0;
+    };
+
+    // index of the first interval with upper() > time (or >= time if touching intervals are included)
+    uint32_t findUpper(size_t time, bool touching) const {
+        if (touching && time == 0) return 0;
+        size_t bound = touching ? time - 1 : time;
+        if (count <= LINEAR_SEARCH_SIZE) {
+            uint32_t i = 0;
+            while (i < count && data[i].upper() <= bound) ++i;
+            return i;
+        }
+        return std::partition_point(data, data + count, [bound](const Interval &interval) {
+            return interval.upper() <= bound;
+        }) - data;
+    };
+
+    // index of the first interval with lower() >= time
+    uint32_t findLower(size_t time) const {
+        if (count <= LINEAR_SEARCH_SIZE) {
+            uint32_t i = 0;
+            while (i < count && data[i].lower() < time) ++i;
+            return i;
+        }
+        return std::partition_point(data, data + count, [time](const Interval &interval) {
+            return interval.lower() < time;
+        }) - data;
+    };
+
+    // replace the intervals in [first, last) with the given ones (at most 2)
+    void replace(uint32_t first, uint32_t last, const Interval *intervals, uint32_t size) {
+        uint32_t newCount = count - (last - first) + size;
+        reserve(newCount);
+        std::memmove(static_cast<void *>(data + first + size), data + last, (count - last) * sizeof(Interval));
+        std::memcpy(static_cast<void *>(data + first), intervals, size * sizeof(Interval));
+        count = newCount;
+    };
+
+public:
+    FlatIntervalSet() : data(getInlineData()) {}
+
+    FlatIntervalSet(const FlatIntervalSet &that) : data(getInlineData()) {
+        reserve(that.count);
+        std::memcpy(static_cast<void *>(data), that.data, that.count * sizeof(Interval));
+        count = that.count;
+    }
+
+    FlatIntervalSet(FlatIntervalSet &&that) noexcept: data(getInlineData()) {
+        moveFrom(that);
+    }
+
+    FlatIntervalSet &operator=(const FlatIntervalSet &that) {
+        if (this != &that) {
+            count = 0;
+            reserve(that.count);
+            std::memcpy(static_cast<void *>(data), that.data, that.count * sizeof(Interval));
+            count = that.count;
+        }
+        return *this;
+    }
+
+    FlatIntervalSet &operator=(FlatIntervalSet &&that) noexcept {
+        if (this != &that) {
+            release();
+            data = getInlineData();
+            capacity = INLINE_CAPACITY;
+            moveFrom(that);
+        }
+        return *this;
+    }
+
+    ~FlatIntervalSet() { release(); }
+
+    bool empty() const { return count == 0; };
+
+    size_t iterative_size() const { return count; };
+
+    const_iterator begin() const { return data; };
+
+    const_iterator end() const { return data + count; };
+
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); };
+
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); };
+
+    // upper bound of the last interval, 0 if empty
+    size_t lastUpper() const { return count ? data[count - 1].upper() : 0; };
+
+    // heap memory in bytes (0 if the intervals are inline)
+    size_t getMemoryUsage() const { return isInline() ? 0 : capacity * sizeof(Interval); };
+
+    // move the intervals back to the inline storage (or a smaller buffer) after they are erased
+    void shrink_to_fit() {
+        if (isInline() || capacity / 2 < count) return;
+        FlatIntervalSet that(*this);
+        *this = std::move(that);
+    };
+
+    // the first interval after [interval.lower(), interval.upper())
+    const_iterator upper_bound(const Interval &interval) const {
+        return data + findLower(interval.upper());
+    };
+
+    bool intersects(const Interval &interval) const {
+        if (interval.lower() >= interval.upper()) return false;
+        auto i = findUpper(interval.lower(), false);
+        return i < count && data[i].lower() < interval.upper();
+    };
+
+    FlatIntervalSet &add(const Interval &interval) {
+        if (interval.lower() >= interval.upper()) return *this;
+        // the intervals overlapping or touching the new one are joined
+        auto first = findUpper(interval.lower(), true);
+        auto last = first;
+        while (last < count && data[last].lower() <= interval.upper()) ++last;
+        Interval joined(interval);
+        if (first < last) {
+            joined = Interval(std::min(interval.lower(), data[first].lower()),
+                              std::max(interval.upper(), data[last - 1].upper()));
+        }
+        replace(first, last, &joined, 1);
+        return *this;
+    };
+
+    FlatIntervalSet &subtract(const Interval &interval) {
+        if (interval.lower() >= interval.upper()) return *this;
+        auto first = findUpper(interval.lower(), false);
+        auto last = first;
+        while (last < count && data[last].lower() < interval.upper()) ++last;
+        if (first == last) return *this;
+        // keep the parts of the first and the last intervals outside the subtracted one
+        Interval remains[2] = {Interval(0, 0), Interval(0, 0)};
+        uint32_t size = 0;
+        if (data[first].lower() < interval.lower()) {
+            remains[size++] = Interval(data[first].lower(), interval.lower());
+        }
+        if (data[last - 1].upper() > interval.upper()) {
+            remains[size++] = Interval(interval.upper(), data[last - 1].upper());
+        }
+        replace(first, last, remains, size);
+        return *this;
+    };
+
+    friend std::ostream &operator<<(std::ostream &os, const FlatIntervalSet &set) {
+        os << "{";
+        for (const auto &interval : set) os << interval;
+        return os << "}";
+    }
+};
+
+inline bool intersects(const FlatIntervalSet &set, const FlatIntervalSet::Interval &interval) {
+    return set.intersects(interval);
+}
+
+inline bool intersects(const FlatIntervalSet::Interval &a, const FlatIntervalSet::Interval &b) {
+    return a.lower() < a.upper() && b.lower() < b.upper() && a.lower() < b.upper() && b.lower() < a.upper();
+}
+
+inline size_t lastUpper(const FlatIntervalSet &set) {
+    return set.lastUpper();
+}
+
+inline size_t lastUpper(const boost::icl::interval_set<size_t> &set) {
+    return set.empty() ? 0 : set.rbegin()->upper();
+}
+
+inline size_t getMemoryUsage(const FlatIntervalSet &set) {
+    return set.getMemoryUsage();
+}
+
+inline size_t getMemoryUsage(const boost::icl::interval_set<size_t> &set) {
+    // an interval and the header of a red-black tree node (color, parent, left, right)
+    return set.iterative_size() * (sizeof(boost::icl::discrete_interval<size_t>) + 4 * sizeof(void *));
+}
+
+inline void shrinkToFit(FlatIntervalSet &set) {
+    set.shrink_to_fit();
+}
+
+inline void shrinkToFit(boost::icl::interval_set<size_t> &) {}
+
+// erase the intervals that end before time (upper() <= time), the others are kept as they are,
+// return the number of erased intervals
+template<typename Set>
+size_t eraseBefore(Set &set, size_t time) {
+    size_t count = 0, upper = 0;
+    for (auto it = set.begin(); it != set.end() && it->upper() <= time; ++it) {
+        ++count;
+        upper = it->upper();
+    }
+    // the next interval starts after upper, so it is not clamped
+    if (count) set.subtract(typename Set::interval_type(0, upper));
+    return count;
+}
+
+// the interval set of the reservations, define MAPF_USE_BOOST_ICL (cmake -DMAPF_USE_BOOST_ICL=ON) to use boost::icl
+#ifdef MAPF_USE_BOOST_ICL
+typedef boost::icl::interval_set<size_t> IntervalSet;
+#else
+typedef FlatIntervalSet IntervalSet;
+#endif
+
+typedef IntervalSet::interval_type Interval;
+
+
+#endif //MAPF_INTERVALSET_H
@@ -0,0 +1,63 @@
+#include "Landmarks.h"
+#include "DistanceTable.h"
+
+#include <algorithm>
+
+Landmarks::Landmarks(const DistanceBuilder &builder, const std::vector<size_t> &cells, size_t count,
+                     const std::vector<size_t> &seeds) {
+    this->count = std::min(count, cells.size());
+    if (this->count == 0) return;
+    distances.assign(cells.size() * this->count, DistanceBuilder::INFINITE_DISTANCE);
+
+    std::vector<uint32_t> row(builder.size()), queue;
+    auto bfs = [&](size_t index) {
+        builder.computeRow(cells[index], false, row.data(), queue);
+    };
+
+    // the first landmark is the farthest cell from the seed, usually on the border of the map
+    size_t next = 0;
+    bfs(seeds.empty() ? 0 : seeds.front());
+    uint32_t farthest = 0;
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (row[cells[i]] != DistanceBuilder::INFINITE_DISTANCE && row[cells[i]] > farthest) {
+            farthest = row[cells[i]];
+            next = i;
+        }
+    }
+
+    // minimum distance of each cell to the selected landmarks, unreachable cells are picked first
+    std::vector<uint32_t> minDistances(cells.size(), DistanceBuilder::INFINITE_DISTANCE);
+    for (size_t l = 0; l < this->count; l++) {
+        landmarks.emplace_back(next);
+        bfs(next);
+        for (size_t i = 0; i < cells.size(); i++) {
+            auto distance = row[cells[i]];
+            distances[i * this->count + l] = distance;
+            minDistances[i] = std::min(minDistances[i], distance);
+        }
+        next = std::max_element(minDistances.begin(), minDistances.end()) - minDistances.begin();
+    }
+}
+
+void Landmarks::update(const DistanceBuilder &builder, const std::vector<size_t> &cells) {
+    std::vector<uint32_t> row(builder.size()), queue;
+    for (size_t l = 0; l < count; l++) {
+        builder.computeRow(cells[landmarks[l]], false, row.data(), queue);
+        for (size_t i = 0; i < cells.size(); i++) {
+            distances[i * count + l] = row[cells[i]];
+        }
+    }
+}
+
+size_t Landmarks::getLowerBound(const uint32_t *a, const uint32_t *b) const {
+    uint32_t result = 0;
+    for (size_t l = 0; l < count; l++) {
+        if (a[l] == DistanceBuilder::INFINITE_DISTANCE || b[l] == DistanceBuilder::INFINITE_DISTANCE) {
+            // a landmark reaches only one of them
+            if (a[l] != b[l]) return DistanceTable::INFINITE_DISTANCE;
+            continue;
+        }
+        result = std::max(result, a[l] > b[l] ? a[l] - b[l] : b[l] - a[l]);
+    }
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef MAPF_LANDMARKS_H
+#define MAPF_LANDMARKS_H
+
+#include "DistanceBuilder.h"
+
+#include <vector>
+#include <cstdint>
+
+// Landmark (ALT) lower bounds of the graph distances, O(k * V) memory instead of O(V^2)
+// for each landmark L, d(a, b) >= |d(L, a) - d(L, b)| by the triangle inequality,
+// the bound is the maximum over all landmarks
+//
+// only the plain distances are used (all cells except '@' are traversable),
+// they are also lower bounds of the endpoint distances since those paths are more restricted
+class Landmarks {
+private:
+    size_t count = 0;
+    std::vector<size_t> landmarks;      // rows (indices of the traversable cells) of the landmarks
+    std::vector<uint32_t> distances;    // cells.size() x count, the distances of a cell to all landmarks are adjacent
+
+public:
+    // pick count landmarks by farthest-point selection, starting from the farthest cell of the first seed
+    // (seeds are indices of the traversable cells, e.g. parking locations)
+    Landmarks(const DistanceBuilder &builder, const std::vector<size_t> &cells, size_t count,
+              const std::vector<size_t> &seeds);
+
+    // recompute the distances of the selected landmarks after the builder grid is changed,
+    // a landmark that is blocked reaches no other cell, so it is skipped by getLowerBound
+    void update(const DistanceBuilder &builder, const std::vector<size_t> &cells);
+
+    auto size() const { return this->count; };
+
+    auto &getLandmarks() const { return this->landmarks; };
+
+    // distances from the landmarks to a cell, size() entries
+    const uint32_t *getDistances(size_t index) const { return distances.data() + index * count; };
+
+    // lower bound of the distance between two cells with the distances to the landmarks of them,
+    // DistanceTable::INFINITE_DISTANCE if they are not connected
+    size_t getLowerBound(const uint32_t *a, const uint32_t *b) const;
+
+    size_t getLowerBound(size_t a, size_t b) const { return getLowerBound(getDistances(a), getDistances(b)); };
+};
+
+
+#endif //MAPF_LANDMARKS_H
@@ -25,9 +25,12 @@ Manager::Manager(std::string dataPath, size_t maxStep, size_t windowSize, int ex
 
 Map *Manager::loadMapFile(const std::string &mapName) {
     auto filePath = dataPath + "/map/" + mapName;
-    auto map = std::make_unique<Map>(filePath);
+    auto map = std::make_unique<Map>(filePath, distanceMode, distanceCacheSize, reservationBackend);
     auto mapPtr = map.get();
     this->maps.emplace(mapName, std::move(map));
+    if (heuristic == Solver::Heuristic::LANDMARK) {
+        mapPtr->initLandmarks(landmarkCount);
+    }
     filePath = dataPath + "/constraints/" + mapName;
     if (mapPtr->loadConstraints(filePath)) {
         std::cerr << "constraints loaded" << std::endl;
@@ -118,6 +121,13 @@ Map *Manager::loadTaskFile(const std::string &filename) {
         }
     }
 
+    std::vector<std::pair<size_t, size_t> > endpoints;
+    for (const auto &task : tasks) {
+        endpoints.emplace_back(task->scenario.getStart());
+        endpoints.emplace_back(task->scenario.getEnd());
+    }
+    map->prewarmDistances(endpoints);
+
     // sort task by deadline for consistency and windowed algorithm
     std::sort(tasks.begin(), tasks.end(),
               [](const auto &a, const auto &b) { return a->scenario.getOptimal() < b->scenario.getOptimal(); });
@@ -125,8 +135,40 @@ Map *Manager::loadTaskFile(const std::string &filename) {
     return map;
 }
 
+std::unique_ptr<Solver> Manager::createSolver(Map *map, int algorithm, int solverExtraCostId) {
+    std::unique_ptr<Solver> solver;
+    if (algorithm == 0 && solverExtraCostId == 0) {
+        solver = std::make_unique<SolverT<SafeIntervalExpansion, PlainOrdering> >(map);
+    } else if (algorithm == 0) {
+        solver = std::make_unique<SolverT<SafeIntervalExpansion, ExtraCostOrdering> >(map, solverExtraCostId);
+    } else if (algorithm == 1 && solverExtraCostId == 0) {
+        solver = std::make_unique<SolverT<ChildExpansion, PlainOrdering> >(map);
+    } else if (algorithm == 1) {
+        solver = std::make_unique<SolverT<ChildExpansion, ExtraCostOrdering> >(map, solverExtraCostId);
+    } else {
+        throw std::runtime_error("unknown algorithm " + std::to_string(algorithm));
+    }
+    solver->setHeuristic(heuristic);
+    solver->setOpenListBackend(openListBackend);
+    return solver;
+}
+
+void Manager::createFlexWorkers(Map *map, int algorithm, int solverExtraCostId) {
+    flexWorkers.clear();
+    flexPool.reset();
+    if (flexThreads <= 1) return;
+    flexPool = std::make_unique<ThreadPool>(flexThreads - 1);
+    flexWorkers.resize(flexPool->size() + 1);
+    for (auto &worker : flexWorkers) {
+        worker.solver = createSolver(map, algorithm, solverExtraCostId);
+    }
+    std::cerr << "flex workers: " << flexWorkers.size() << " threads" << std::endl;
+}
+
 void Manager::leastFlexFirstAssign(Map *map, int algorithm, double phi) {
-    Solver solver(map, algorithm, extraCostId);
+    auto solverPtr = createSolver(map, algorithm, extraCostId);
+    auto &solver = *solverPtr;
+    createFlexWorkers(map, algorithm, extraCostId);
 
     // add node constraints for parking locations
     for (size_t i = 0; i < agents.size(); i++) {
@@ -138,15 +180,20 @@ void Manager::leastFlexFirstAssign(Map *map, int algorithm, double phi) {
 
     auto start = std::chrono::system_clock::now();
 
+    size_t iteration = 0;
     while (!tasks.empty()) {
         computeFlex(solver, 1, phi);
         selectTask(solver, 1, phi);
+        if (collectInterval > 0 && ++iteration % collectInterval == 0) {
+            collectReservations(map);
+        }
         auto end = std::chrono::system_clock::now();
         auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         std::cout << "time: " << time << "ms" << std::endl;
     }
 
     applyReservedPath();
+    solver.printAllocationStats();
 
     auto end = std::chrono::system_clock::now();
     auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -156,7 +203,8 @@ void Manager::leastFlexFirstAssign(Map *map, int algorithm, double phi) {
 }
 
 void Manager::earliestDeadlineFirstAssign(Map *map, int algorithm, double phi) {
-    Solver solver(map, algorithm);
+    auto solverPtr = createSolver(map, algorithm, 0);
+    auto &solver = *solverPtr;
     std::vector<std::pair<size_t, double> > sortAgent(agents.size());
 
     // add node constraints for parking locations
@@ -194,9 +242,13 @@ void Manager::earliestDeadlineFirstAssign(Map *map, int algorithm, double phi) {
         } else {
             std::cout << "fail task " << tasks[j]->scenario.getBucket() << std::endl;
         }
+        if (collectInterval > 0 && (j + 1) % collectInterval == 0) {
+            collectReservations(map);
+        }
     }
 
     applyReservedPath();
+    solver.printAllocationStats();
 
     auto end = std::chrono::system_clock::now();
     auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -205,6 +257,17 @@ void Manager::earliestDeadlineFirstAssign(Map *map, int algorithm, double phi) {
     std::cerr << "time: " << time << "ms" << std::endl;
 }
 
+void Manager::collectReservations(Map *map) {
+    size_t watermark = std::numeric_limits<size_t>::max();
+    for (auto &agent : agents) {
+        watermark = std::min(watermark, agent.lastTimeStamp);
+    }
+    if (agents.empty() || watermark == 0) return;
+    auto stats = map->collectReservations(watermark);
+    std::cerr << "collect reservations before " << watermark << ": " << stats.intervals << " intervals, "
+              << stats.bytes << " bytes" << std::endl;
+}
+
 void Manager::applyReservedPath() {
     for (size_t i = 0; i < agents.size(); i++) {
         auto &agent = agents[i];
@@ -216,7 +279,8 @@ void Manager::applyReservedPath() {
 }
 
 size_t Manager::computeAgentForTask(Solver &solver, size_t j, const std::vector<std::pair<size_t, double> > &sortAgent,
-                                    double phi, double &minBeta, size_t &minBetaTask, Count &count, bool recalculate) {
+                                    double phi, double &minBeta, size_t &minBetaTask, Count &count, bool recalculate,
+                                    size_t budget) {
     auto map = solver.getMap();
     auto &task = tasks[j];
 
@@ -302,126 +366,171 @@ size_t Manager::computeAgentForTask(Solver &solver, size_t j, const std::vector<
     }
 
 
-    for (auto &p : sortAgent) {
+    // algorithm 2 line 6 (d*), the lower bounds of all agents at once
+    agentBounds.resize(sortAgent.size());
+    for (size_t k = 0; k < sortAgent.size(); k++) {
+        auto &agent = agents[sortAgent[k].first];
+        agentBounds.setAgent(k, map->getCellId(agent.currentPos), agent.lastTimeStamp);
+    }
+    size_t taskDistance;
+    if (heuristic == Solver::Heuristic::LANDMARK) {
+        // a weaker bound, but it does not need the endpoint distances
+        for (size_t k = 0; k < sortAgent.size(); k++) {
+            auto &agent = agents[sortAgent[k].first];
+            agentBounds.setDistance(k, map->getLandmarkDistance(agent.currentPos, task->scenario.getStart()));
+        }
+        taskDistance = map->getLandmarkDistance(task->scenario.getStart(), task->scenario.getEnd());
+    } else {
+        map->getGraphDistancesEndpoint(map->getCellId(task->scenario.getStart()), agentBounds.getPositions(),
+                                       agentBounds.getDistances());
+        taskDistance = map->getGraphDistanceEndpoint(task->scenario.getStart(), task->scenario.getEnd());
+    }
+    agentBounds.compute(taskDistance);
+
+    // the agents already calculated or cached are not calculated again
+    auto isCalculated = [&](const Agent &agent) {
+        auto &flex = agent.flexibility[j];
+        if (recalculate) return flex.beta >= 0 && !flex.path.empty();
+        return skipFlag && !flex.path.empty();
+    };
+    // the upper bound of the searches of an agent, in recalculate mode based on the time spent by the best agent
+    auto getAgentUpperBound = [&](const Agent &agent) {
+        if (!recalculate) return upperBound;
+        size_t agentUpperBound = upperBound;
+        if (taskMinAgentTime < std::numeric_limits<size_t>::max() / 2) {
+            agentUpperBound = agent.lastTimeStamp + taskMinAgentTime;
+        }
+        return std::min(agentUpperBound, (size_t) deadline + 1);
+    };
+    auto skipAgent = [&](Agent &agent, double beta) {
+        if (beta < 0) beta = -1;
+        else if (beta < minBeta) beta = minBeta;
+        agent.flexibility[j] = Flexibility{beta, std::vector<PathNode>(), task.get(), 0};
+        count.skip++;
+    };
+
+    // the upper bound only decreases in the loop below (in recalculate mode, it is at most the deadline),
+    // so the agents pruned by the current one are skipped first and only the candidates are visited in order
+    size_t candidateBound = recalculate ? (size_t) deadline + 1 : upperBound;
+    auto &candidates = agentBounds.getCandidates(candidateBound);
+    for (size_t k = 0, next = 0; k < sortAgent.size(); k++) {
+        if (next < candidates.size() && candidates[next] == k) {
+            ++next;
+        } else if (!isCalculated(agents[sortAgent[k].first])) {
+            skipAgent(agents[sortAgent[k].first], sortAgent[k].second);
+        }
+    }
+
+    // in a parallel pass, the candidates are evaluated on the workers in waves, with the upper bounds they would
+    // have if no candidate before them changed the bounds, the loop below only uses an evaluation whose bound is
+    // still the same and evaluates the agent again otherwise, so the results are the same as in a serial pass
+    //
+    // a path found with flexibility often tightens the bounds or skips the rest of the task, so a wave starts
+    // with one candidate (evaluated by the loop itself) and doubles up to the number of workers while the bounds
+    // do not change, so that little is evaluated in vain
+    bool parallel = !flexWorkers.empty() && flexWorkers.front().solver->getMap() == map;
+
+    // the searches of the task use what is left of its budget in turn (a path found by one of them usually prunes
+    // the others), once it is used up the candidates are not searched and deferred with their lower bounds
+    auto budgetStart = std::chrono::steady_clock::now();
+    auto getBudgetLeft = [&]() -> size_t {
+        auto elapsed = (size_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - budgetStart).count();
+        return elapsed < budget ? budget - elapsed : 0;
+    };
+    size_t deferredLowerBound = infinite;   // the smallest lower bound of the agents deferred by the budget
+    auto deferAgent = [&](Agent &agent, size_t lowerBound) {
+        // it is unknown whether the agent has a path within the bound, so the flexibility is not cached
+        // (the agent is evaluated again in the next pass) and the task is not failed because of it
+        agent.flexibility[j] = Flexibility{-1, std::vector<PathNode>(), task.get(), 0};
+        deferredLowerBound = std::min(deferredLowerBound, lowerBound);
+    };
+    std::vector<Evaluation> evaluations(candidates.size());
+    std::vector<size_t> wave;
+    size_t waveSize = 1, boundChangeCount = 0, waveBoundChangeCount = 0;
+    auto evaluateWave = [&](size_t first) {
+        wave.clear();
+        size_t c = first;
+        for (; c < candidates.size() && wave.size() < waveSize; c++) {
+            auto &agent = agents[sortAgent[candidates[c]].first];
+            if (isCalculated(agent)) continue;
+            evaluations[c].upperBound = getAgentUpperBound(agent);
+            if (!agentBounds.isPruned(candidates[c], evaluations[c].upperBound)) wave.emplace_back(c);
+        }
+        size_t budgetLeft = budget > 0 ? getBudgetLeft() : 0;
+        if (wave.size() > 1 && (budget == 0 || budgetLeft > 0)) {
+            flexPool->parallelFor(0, wave.size(), 1, [&](size_t w) {
+                auto &worker = flexWorkers[flexPool->getWorkerIndex()];
+                auto &evaluation = evaluations[wave[w]];
+                evaluateAgent(*worker.solver, sortAgent[candidates[wave[w]]].first, j, evaluation.upperBound,
+                              budgetLeft, evaluation);
+            });
+        }
+        return c;
+    };
+
+    for (size_t c = 0, waveEnd = 0; c < candidates.size(); c++) {
+        if (parallel && !skipAllFlag && c >= waveEnd) {
+            if (waveEnd > 0) {
+                waveSize = boundChangeCount > waveBoundChangeCount ? 1 : std::min(waveSize * 2, flexWorkers.size());
+            }
+            waveBoundChangeCount = boundChangeCount;
+            waveEnd = evaluateWave(c);
+        }
+        auto k = candidates[c];
+        auto &p = sortAgent[k];
         auto i = p.first;
         auto &agent = agents[i];
         auto agentLeaveTime = agent.lastTimeStamp;
-        std::vector<PathNode> path;
-//        const auto deliveryOccupiedAgent = occupiedAgent.second;
 
+        if (isCalculated(agent)) {
+            // skip already calculated agent or use previous result
+            continue;
+        }
         if (recalculate) {
-            // skip already calculated agent
-            if (agent.flexibility[j].beta >= 0 && !agent.flexibility[j].path.empty()) {
-                continue;
-            }
             // recalculate based on time spent by agent, not flexibility
-            if (taskMinAgentTime < std::numeric_limits<size_t>::max() / 2) {
-                upperBound = agent.lastTimeStamp + taskMinAgentTime;
-            }
-            upperBound = std::min(upperBound, (size_t) deadline + 1);
-        } else {
-            // use previous result
-            if (skipFlag && !agent.flexibility[j].path.empty()) {
-                continue;
-            }
+            upperBound = getAgentUpperBound(agent);
         }
 
-        // algorithm 2 line 6 (d*)
-        size_t agentMinTime = map->getGraphDistanceEndpoint(agent.currentPos, task->scenario.getStart()) +
-                              map->getGraphDistanceEndpoint(task->scenario.getStart(), task->scenario.getEnd());
-        if (skipAllFlag || agent.lastTimeStamp + agentMinTime > upperBound) {
-            auto beta = p.second;
-            if (beta < 0) beta = -1;
-            else if (beta < minBeta) beta = minBeta;
-            agent.flexibility[j] = Flexibility{beta, path, task.get(), 0};
-            count.skip++;
+        if (skipAllFlag || agentBounds.isPruned(k, upperBound)) {
+            skipAgent(agent, p.second);
             continue;
         }
 
-        // if an agent is at start pos, skip other agents
-        /*if (occupiedFlag && occupiedAgent[j].first < agents.size() && occupiedAgent[j].first != i) {
-            agent.flexibility.emplace_back(Flexibility{-1, path, task.get(), deliveryOccupiedAgent});
-            skipCount++;
-            continue;
-        }*/
-
-        // clear node constraint for parking location of the current agent
-//        map->removeNodeOccupied(agent.currentPos, agentLeaveTime);
-        if (agent.reservedPath.empty()) {
-            map->removeNodeOccupied(agent.currentPos, agent.lastTimeStamp, agent.lastTimeStamp + 1);
-        }
-        const auto infiniteWaiting = map->removeInfiniteWaiting(agent.reservePos);
-//        std::cout << infiniteWaiting << std::endl;
-        if (!agent.reservedPath.empty()) {
-//            for (auto item : agent.reservedPath) {
-//                std::cerr << item.pos.first << " " << item.pos.second << " " << item.leaveTime << std::endl;
-//            }
-            removeAgentPathConstraints(map, agent, agent.reservedPath);
-        }
-
-//        if (infiniteWaiting != infinite) {
-//            std::cerr << i << " " << j << std::endl;
-//        }
-//        map->removeWaitingAgent(agent.currentPos, agent.lastTimeStamp, i);
-
-        const auto deliveryOccupiedAgent = map->getLastWaitingAgent(task->scenario.getEnd());
-
-        // if an agent is at end pos, remove its node constraint
-//        if (occupiedFlag && deliveryOccupiedAgent < agents.size()) {
-//            map->removeNodeOccupied(agents[deliveryOccupiedAgent].currentPos,
-//                                    agents[deliveryOccupiedAgent].lastTimeStamp);
-//            map->removeWaitingAgent(agents[deliveryOccupiedAgent].currentPos,
-//                                    agents[deliveryOccupiedAgent].lastTimeStamp, deliveryOccupiedAgent);
-//        }
-
-//            double deadline = (1 + phi) * task->getOptimal();
-//            auto &upperBound = upperBounds[j];
-
-
-        size_t agentStartTime = 0, agentEndTime = 0;
-        size_t distance = Map::getDistance(agent.currentPos, task->scenario.getStart());
-        if (deadlineBoundFlag && agentMaxReserveTimestamp + distance < task->scenario.getStartTime()) {
-            task->released = false;
-        } else if (multiLabelFlag) {
-            std::vector<std::pair<size_t, size_t> > positions = {
-                    agent.currentPos, task->scenario.getStart(), task->scenario.getEnd()
-            };
-            auto scenario = Scenario(i, map, positions, 0, 0);
-            auto scenarioPath = computePath(solver, path, &scenario, agentLeaveTime, upperBound);
-            for (auto &node: path) {
-                if (node.pos == task->scenario.getStart()) {
-                    agentStartTime = node.leaveTime;
-                    break;
-                }
-            }
-            if (agentStartTime > 0 && agentStartTime >= task->scenario.getStartTime()) {
-                agentEndTime = scenarioPath.first;
-            }
-            count.step += scenarioPath.second;
-        } else {
-            // agent go to task start position
-            auto scenario = Scenario(i, map, agent.currentPos, task->scenario.getStart(), 0, 0);
-            auto scenarioPath = computePath(solver, path, &scenario, agentLeaveTime, upperBound);
-
-            agentStartTime = scenarioPath.first;
-            count.step += scenarioPath.second;
-            if (agentStartTime > 0 && agentStartTime >= task->scenario.getStartTime()) {
-                scenarioPath = computePath(solver, path, &task->scenario, agentStartTime, upperBound);
-                agentEndTime = scenarioPath.first;
-                count.step += scenarioPath.second;
+        auto &evaluation = evaluations[c];
+        if (!evaluation.evaluated || evaluation.upperBound != upperBound) {
+            evaluation = Evaluation();
+            size_t budgetLeft = budget > 0 ? getBudgetLeft() : 0;
+            if (budget > 0 && budgetLeft == 0) {
+                deferAgent(agent, agentBounds.getBound(k));
+                count.skip++;
+                continue;
             }
+            evaluateAgent(solver, i, j, upperBound, budgetLeft, evaluation);
         }
+        auto &path = evaluation.path;
+        auto deliveryOccupiedAgent = evaluation.deliveryOccupiedAgent;
+        count.step += evaluation.steps;
 
-        if (agentStartTime > 0 && agentStartTime < task->scenario.getStartTime()) {
+        if (!evaluation.released) {
             task->released = false;
         }
-        if (agentEndTime == 0) {
-            agent.flexibility[j] = Flexibility{-1, path, task.get(), deliveryOccupiedAgent};
+        if (evaluation.budgetUsedUp && evaluation.lowerBound < upperBound) {
+            deferAgent(agent, evaluation.lowerBound);
+            count.calculate++;
+            continue;
+        }
+        auto previousUpperBound = upperBound;
+        auto previousAgentTime = taskMinAgentTime;
+        if (evaluation.agentEndTime == 0) {
+            agent.flexibility[j] = Flexibility{-1, std::move(path), task.get(), deliveryOccupiedAgent,
+                                               evaluation.conflictFree};
         } else {
-            size_t pathLength = agentEndTime - agentLeaveTime;
+            size_t pathLength = evaluation.agentEndTime - agentLeaveTime;
             double beta = deadline;
             beta -= (double) (agentLeaveTime + pathLength);
-            agent.flexibility[j] = Flexibility{beta, path, task.get(), deliveryOccupiedAgent};
+            agent.flexibility[j] = Flexibility{beta, std::move(path), task.get(), deliveryOccupiedAgent,
+                                               evaluation.conflictFree};
             if (beta >= 0) {
                 if (boundFlag) {
                     if (minBeta >= 0 && beta > minBeta) {
@@ -444,27 +553,9 @@ size_t Manager::computeAgentForTask(Solver &solver, size_t j, const std::vector<
                 }
             }
         }
-
-        // add back node constraint for parking location of the current agent
-//        map->addNodeOccupied(agent.currentPos, agentLeaveTime, std::numeric_limits<size_t>::max() / 2);
-        if (!agent.reservedPath.empty()) {
-            addAgentPathConstraints(map, agent, agent.reservedPath);
-        }
-        map->addInfiniteWaiting(agent.reservePos, infiniteWaiting);
-        if (agent.reservedPath.empty()) {
-            map->addNodeOccupied(agent.currentPos, agent.lastTimeStamp, agent.lastTimeStamp + 1);
+        if (upperBound != previousUpperBound || taskMinAgentTime != previousAgentTime) {
+            ++boundChangeCount;
         }
-
-
-//        map->addWaitingAgent(agent.currentPos, agent.lastTimeStamp, i);
-
-//        if (occupiedFlag && deliveryOccupiedAgent < agents.size()) {
-//            map->addNodeOccupied(agents[deliveryOccupiedAgent].currentPos,
-//                                 agents[deliveryOccupiedAgent].lastTimeStamp,
-//                                 std::numeric_limits<size_t>::max() / 2);
-//            map->addWaitingAgent(agents[deliveryOccupiedAgent].currentPos,
-//                                 agents[deliveryOccupiedAgent].lastTimeStamp, deliveryOccupiedAgent);
-//        }
         count.calculate++;
         //            if (agent.flexibility.back().beta >= 0) {
 //        std::cout << "calculate: " << i << " " << j << " " << agent.flexibility[j].beta << std::endl;
@@ -477,6 +568,12 @@ size_t Manager::computeAgentForTask(Solver &solver, size_t j, const std::vector<
 
     task->maxBeta = taskMaxBeta;
     task->maxBetaAgent = taskSelectedAgent;
+    if (deferredLowerBound < upperBound && taskSelectedAgent >= agents.size()) {
+        // defer the task to the next pass, where it is sorted by the upper bound of its flexibility
+        task->released = false;
+        task->maxBeta = deadline - (double) deferredLowerBound;
+        ++budgetDeferredCount;
+    }
 
 
     if (!skipAllFlag && taskMaxBeta >= 0 &&
@@ -491,6 +588,102 @@ size_t Manager::computeAgentForTask(Solver &solver, size_t j, const std::vector<
 }
 
 
+void Manager::evaluateAgent(Solver &solver, size_t i, size_t j, size_t upperBound, size_t budget,
+                            Evaluation &evaluation) {
+    auto map = solver.getMap();
+    auto &agent = agents[i];
+    auto &task = tasks[j];
+    auto agentLeaveTime = agent.lastTimeStamp;
+    evaluation.upperBound = upperBound;
+    evaluation.evaluated = true;
+
+    // clear the constraints of the current agent (parking location, infinite waiting and reserved path)
+    maskAgentReservations(solver, agent);
+
+//        map->removeWaitingAgent(agent.currentPos, agent.lastTimeStamp, i);
+
+    evaluation.deliveryOccupiedAgent = map->getLastWaitingAgent(task->scenario.getEnd());
+
+    // if an agent is at end pos, remove its node constraint
+//        if (occupiedFlag && deliveryOccupiedAgent < agents.size()) {
+//            map->removeNodeOccupied(agents[deliveryOccupiedAgent].currentPos,
+//                                    agents[deliveryOccupiedAgent].lastTimeStamp);
+//            map->removeWaitingAgent(agents[deliveryOccupiedAgent].currentPos,
+//                                    agents[deliveryOccupiedAgent].lastTimeStamp, deliveryOccupiedAgent);
+//        }
+
+    size_t &agentStartTime = evaluation.agentStartTime, &agentEndTime = evaluation.agentEndTime;
+    size_t distance = Map::getDistance(agent.currentPos, task->scenario.getStart());
+    if (deadlineBoundFlag && agentMaxReserveTimestamp + distance < task->scenario.getStartTime()) {
+        evaluation.released = false;
+    } else if (multiLabelFlag) {
+        std::vector<std::pair<size_t, size_t> > positions = {
+                agent.currentPos, task->scenario.getStart(), task->scenario.getEnd()
+        };
+        auto scenario = Scenario(i, map, positions, 0, 0);
+        size_t lowerBound;
+        auto scenarioPath = computePath(solver, evaluation.path, &scenario, agentLeaveTime, upperBound, budget,
+                                        &lowerBound);
+        if (lowerBound > 0) {
+            evaluation.budgetUsedUp = true;
+            evaluation.lowerBound = lowerBound;
+        }
+        for (auto &node: evaluation.path) {
+            if (node.pos == map->getCellId(task->scenario.getStart())) {
+                agentStartTime = node.leaveTime;
+                break;
+            }
+        }
+        if (agentStartTime > 0 && agentStartTime >= task->scenario.getStartTime()) {
+            agentEndTime = scenarioPath.first;
+        }
+        evaluation.steps += scenarioPath.second;
+    } else {
+        // agent go to task start position
+        auto scenario = Scenario(i, map, agent.currentPos, task->scenario.getStart(), 0, 0);
+        size_t lowerBound;
+        auto scenarioPath = computePath(solver, evaluation.path, &scenario, agentLeaveTime, upperBound, budget,
+                                        &lowerBound);
+        if (lowerBound > 0) {
+            // the agent leaves the task start position no earlier than the lower bound
+            evaluation.budgetUsedUp = true;
+            evaluation.lowerBound = lowerBound + task->scenario.getDistance();
+        }
+
+        agentStartTime = scenarioPath.first;
+        evaluation.steps += scenarioPath.second;
+        if (agentStartTime > 0 && agentStartTime >= task->scenario.getStartTime()) {
+            scenarioPath = computePath(solver, evaluation.path, &task->scenario, agentStartTime, upperBound, budget,
+                                       &lowerBound);
+            if (lowerBound > 0) {
+                evaluation.budgetUsedUp = true;
+                evaluation.lowerBound = lowerBound;
+            }
+            agentEndTime = scenarioPath.first;
+            evaluation.steps += scenarioPath.second;
+        }
+    }
+
+    if (agentStartTime > 0 && agentStartTime < task->scenario.getStartTime()) {
+        evaluation.released = false;
+    }
+    // the paths of the child expansion (-a 1) may conflict with the reservations,
+    // so a path is only known to be conflict free if it is checked here
+    evaluation.conflictFree = skipFlag && !evaluation.path.empty() && !isPathConflict(solver, agent, evaluation.path);
+
+    solver.getOverlay().clear();
+
+//        map->addWaitingAgent(agent.currentPos, agent.lastTimeStamp, i);
+
+//        if (occupiedFlag && deliveryOccupiedAgent < agents.size()) {
+//            map->addNodeOccupied(agents[deliveryOccupiedAgent].currentPos,
+//                                 agents[deliveryOccupiedAgent].lastTimeStamp,
+//                                 std::numeric_limits<size_t>::max() / 2);
+//            map->addWaitingAgent(agents[deliveryOccupiedAgent].currentPos,
+//                                 agents[deliveryOccupiedAgent].lastTimeStamp, deliveryOccupiedAgent);
+//        }
+}
+
 bool Manager::reservePath(Solver &solver, size_t i) {
     auto map = solver.getMap();
     auto &agent = agents[i];
@@ -543,7 +736,7 @@ bool Manager::assignTask(Solver &solver, size_t i, std::vector<PathNode> &vector
     auto map = solver.getMap();
     auto &agent = agents[i];
     bool result = true;
-    if (vector[0].pos != agent.currentPos) {
+    if (vector[0].pos != map->getCellId(agent.currentPos)) {
         throw std::runtime_error("agent position error!");
     }
 
@@ -585,14 +778,14 @@ bool Manager::assignTask(Solver &solver, size_t i, std::vector<PathNode> &vector
                 if (j >= agents.size()) continue;
                 if (map->isParkingLocation(agents[j].reservePos)) continue;
                 if (!agents[j].reservedPath.empty() || agents[j].lastTimeStamp > node.leaveTime) continue;
-                if (agents[j].reservePos == node.pos) continue;
+                if (map->getCellId(agents[j].reservePos) == node.pos) continue;
                 reservingAgentSet.emplace(j, 1);
             }
         }
     }
     if (reservingAgentSet.empty()) {
         // no overlapping
-        agent.currentPos = vector.back().pos;
+        agent.currentPos = map->getPos(vector.back().pos);
         agent.lastTimeStamp = vector.back().leaveTime;
         agent.reservedPath.clear();
         map->addWaitingAgent(agent.currentPos, agent.lastTimeStamp, i);
@@ -603,7 +796,7 @@ bool Manager::assignTask(Solver &solver, size_t i, std::vector<PathNode> &vector
         std::vector<PathNode> tempReservedPath;
         tempReservedPath.swap(agent.reservedPath);
 
-        agent.currentPos = vector.back().pos;
+        agent.currentPos = map->getPos(vector.back().pos);
         agent.lastTimeStamp = vector.back().leaveTime;
 
         std::vector<std::pair<size_t, Agent> > savedAgents;
@@ -688,7 +881,7 @@ bool Manager::assignTask(Solver &solver, size_t i, std::vector<PathNode> &vector
         std::vector<PathNode> tempReservedPath;
         tempReservedPath.swap(agent.reservedPath);
 
-        agent.currentPos = vector.back().pos;
+        agent.currentPos = map->getPos(vector.back().pos);
         agent.lastTimeStamp = vector.back().leaveTime;
 
         size_t reservingAgent;
@@ -719,7 +912,7 @@ bool Manager::assignTask(Solver &solver, size_t i, std::vector<PathNode> &vector
     } else {
         // no overlapping
 //        agent.currentPos = agent.waitingPos = vector.back().pos;
-        agent.currentPos = vector.back().pos;
+        agent.currentPos = map->getPos(vector.back().pos);
 //        agent.lastTimeStamp = agent.waitingTimeStamp = vector.back().leaveTime;
         agent.lastTimeStamp = vector.back().leaveTime;
         agent.reservedPath.clear();
@@ -747,7 +940,7 @@ Manager::generateConstraints(Map *map, Agent &agent, const std::vector<PathNode>
         result.emplace_back(Constraint{vector[j].pos, Map::Direction::NONE, vector[j - 1].leaveTime + 1, endTime});
 //        std::cerr << vector[j].pos.first << " " << vector[j].pos.second << " " << vector[j - 1].leaveTime + 1 << std::endl;
         //        map->addNodeOccupied(vector[j].pos, vector[j - 1].leaveTime + 1, endTime);
-        auto dir = map->getDirectionByPos(vector[j - 1].pos, vector[j].pos);
+        auto dir = map->getDirectionByCell(vector[j - 1].pos, vector[j].pos);
         if (dir == Map::Direction::NONE) {
             continue;
 //            throw std::runtime_error("");
@@ -775,6 +968,22 @@ void Manager::removeAgentPathConstraints(Map *map, Agent &agent, const std::vect
     }
 }
 
+void Manager::maskAgentReservations(Solver &solver, Agent &agent) {
+    auto map = solver.getMap();
+    auto &overlay = solver.getOverlay();
+    overlay.clear();
+    if (agent.reservedPath.empty()) {
+        overlay.removeNodeOccupied(map->getCellId(agent.currentPos), agent.lastTimeStamp, agent.lastTimeStamp + 1);
+    }
+    overlay.removeInfiniteWaiting(map->getCellId(agent.reservePos));
+    if (!agent.reservedPath.empty()) {
+        auto constraints = generateConstraints(map, agent, agent.reservedPath);
+        for (auto &constraint: constraints) {
+            overlay.removeEdgeOccupied(constraint.pos, constraint.direction, constraint.start, constraint.end);
+        }
+    }
+}
+
 void Manager::selectTask(Solver &solver, int x, double phi) {
     auto map = solver.getMap();
     double minFlex = std::numeric_limits<double>::max();
@@ -909,19 +1118,25 @@ void Manager::selectTask(Solver &solver, int x, double phi) {
         }
     }
     tasks.swap(newTasks);
+    flexBudgetStalled = budgetDeferredCount > 0 && !taskSuccess;
 }
 
 
 std::pair<size_t, size_t> Manager::computePath(Solver &solver, std::vector<PathNode> &path,
-                                               Scenario *task, size_t startTime, size_t deadline) {
+                                               Scenario *task, size_t startTime, size_t deadline, size_t budget,
+                                               size_t *lowerBound) {
     size_t count = 0;
+    if (lowerBound) *lowerBound = 0;
     // skip if not possible to succeed
     if (startTime + task->getDistance() > deadline) {
         return std::make_pair(0, count);
     }
     solver.initScenario(task, startTime, deadline);
-    while (!solver.success() && solver.step() && count < maxStep) {
-        ++count;
+    auto result = solver.search(maxStep, budget);
+    count = result.steps;
+    if (result.status == Solver::SearchResult::Status::BUDGET) {
+        ++budgetUsedUpCount;
+        if (lowerBound) *lowerBound = result.lowerBound;
     }
     if (!solver.success()) {
         return std::make_pair(0, count);
@@ -940,6 +1155,8 @@ bool Manager::isPathConflict(Solver &solver, Agent &agent, const std::vector<Pat
     // if no path we need recalculate?
     if (vector.empty()) return true;
     auto map = solver.getMap();
+    // the agent has moved since the path was computed, the reservations before it may be collected
+    if (vector[0].pos != map->getCellId(agent.currentPos) || vector[0].leaveTime < agent.lastTimeStamp) return true;
     auto constraints = generateConstraints(map, agent, vector);
     for (auto &constraint:constraints) {
         if (solver.isOccupied(constraint.pos, constraint.direction, constraint.start, constraint.end)) {
@@ -949,8 +1166,68 @@ bool Manager::isPathConflict(Solver &solver, Agent &agent, const std::vector<Pat
     return false;
 }
 
+void Manager::indexPath(const Agent &agent, Flexibility &flexibility) {
+    flexibility.version = ++pathVersion;
+    const auto &vector = flexibility.path;
+    for (size_t j = 0; j < vector.size(); j++) {
+        // the path occupies a cell from the time it leaves the previous cell to one after it leaves the cell
+        // (the edge constraints are in the windows of their cells)
+        size_t startTime = j == 0 ? agent.lastTimeStamp : vector[j - 1].leaveTime;
+        size_t endTime = vector[j].leaveTime + 1;
+        for (size_t bucket = startTime >> PATH_INDEX_BUCKET_BITS;
+             startTime < endTime && bucket <= (endTime - 1) >> PATH_INDEX_BUCKET_BITS; bucket++) {
+            pathIndex[bucket][vector[j].pos].emplace_back(PathRef{flexibility.version, startTime, endTime});
+        }
+    }
+}
+
+void Manager::collectStalePaths(Map *map) {
+    auto markStale = [this](Map::CellId id, size_t startTime, size_t endTime) {
+        for (auto it = pathIndex.lower_bound(startTime >> PATH_INDEX_BUCKET_BITS);
+             it != pathIndex.end() && it->first <= (endTime - 1) >> PATH_INDEX_BUCKET_BITS; ++it) {
+            auto cell = it->second.find(id);
+            if (cell == it->second.end()) continue;
+            for (const auto &ref : cell->second) {
+                if (ref.startTime < endTime && startTime < ref.endTime) stalePaths.insert(ref.version);
+            }
+        }
+    };
+    for (const auto &change : map->getOccupiedJournal()) {
+        markStale(change.id, change.startTime, change.endTime);
+        // an edge constraint of a path is in the window of one of its cells, check both
+        if (change.direction != Map::Direction::NONE) {
+            markStale(map->getNeighbor(change.id, change.direction), change.startTime, change.endTime);
+        }
+    }
+    map->clearOccupiedJournal();
+
+    // removing intervals never adds a conflict, and no interval is added before the earliest time of the agents
+    size_t watermark = std::numeric_limits<size_t>::max();
+    for (const auto &agent : agents) watermark = std::min(watermark, agent.lastTimeStamp);
+    while (!pathIndex.empty() && (pathIndex.begin()->first + 1) << PATH_INDEX_BUCKET_BITS <= watermark) {
+        pathIndex.erase(pathIndex.begin());
+    }
+}
+
+bool Manager::isCachedPathConflict(Solver &solver, Agent &agent, const Flexibility &flexibility) {
+    ++cachedPathCount;
+    const auto &vector = flexibility.path;
+    if (vector.empty()) return true;
+    auto map = solver.getMap();
+    if (vector[0].pos != map->getCellId(agent.currentPos) || vector[0].leaveTime < agent.lastTimeStamp) return true;
+    if (flexibility.version != 0 && stalePaths.find(flexibility.version) == stalePaths.end()) return false;
+    ++checkedPathCount;
+    return isPathConflict(solver, agent, vector);
+}
+
 void Manager::computeFlex(Solver &solver, int x, double phi) {
     auto map = solver.getMap();
+    // the reservations are only changed temporarily in the pass, so they are not recorded
+    if (skipFlag) {
+        collectStalePaths(map);
+        map->setJournalEnabled(false);
+        cachedPathCount = checkedPathCount = 0;
+    }
 //    size_t calculateCount = 0, skipCount = 0;
 //    size_t stepCount = 0;
 /*    std::vector<size_t> upperBounds;
@@ -1006,16 +1283,8 @@ void Manager::computeFlex(Solver &solver, int x, double phi) {
         agent.flexibility.resize(tasks.size());
         size_t prevIndex = 0;
 
-        size_t infiniteWaiting = 0;
-
         if (skipFlag) {
-            if (agent.reservedPath.empty()) {
-                map->removeNodeOccupied(agent.currentPos, agent.lastTimeStamp, agent.lastTimeStamp + 1);
-            }
-            infiniteWaiting = map->removeInfiniteWaiting(agent.reservePos);
-            if (!agent.reservedPath.empty()) {
-                removeAgentPathConstraints(map, agent, agent.reservedPath);
-            }
+            maskAgentReservations(solver, agent);
         }
 
         for (size_t j = 0; j < tasks.size(); j++) {
@@ -1030,8 +1299,9 @@ void Manager::computeFlex(Solver &solver, int x, double phi) {
             if (prevIndex < prevFlexibility.size()) {
                 beta = prevFlexibility[prevIndex].beta;
                 // use prev flexibility if no conflict
-                if (skipFlag && !isPathConflict(solver, agent, prevFlexibility[prevIndex].path)) {
-                    agent.flexibility[j] = prevFlexibility[prevIndex];
+                if (skipFlag && !isCachedPathConflict(solver, agent, prevFlexibility[prevIndex])) {
+                    agent.flexibility[j] = std::move(prevFlexibility[prevIndex]);
+                    agent.flexibility[j].conflictFree = true;
                 }
             } else {
                 // here we use the graph distance to sort for beta < 0
@@ -1043,20 +1313,21 @@ void Manager::computeFlex(Solver &solver, int x, double phi) {
         }
 
         if (skipFlag) {
-            if (!agent.reservedPath.empty()) {
-                addAgentPathConstraints(map, agent, agent.reservedPath);
-            }
-            map->addInfiniteWaiting(agent.reservePos, infiniteWaiting);
-            if (agent.reservedPath.empty()) {
-                map->addNodeOccupied(agent.currentPos, agent.lastTimeStamp, agent.lastTimeStamp + 1);
-            }
+            solver.getOverlay().clear();
         }
     }
 
+    // the budget left in the pass is split over the tasks still computed (and used by their searches in turn),
+    // so the time of the reused and pruned agent and task pairs goes to the later searches
+    bool budgeted = flexBudget > 0 && !flexBudgetStalled;
+    auto budgetEnd = std::chrono::steady_clock::now() + std::chrono::microseconds(flexBudget);
+    budgetUsedUpCount = 0;
+    budgetDeferredCount = 0;
+
     Count count;
 //    size_t taskCalculated = 0;
-    for (auto _p : sortTasks) {
-        auto j = _p.first;
+    for (size_t k = 0; k < sortTasks.size(); k++) {
+        auto j = sortTasks[k].first;
         auto &task = tasks[j];
 //        if (windowSize > 0 && taskCalculated >= windowSize) {
 //            task->released = false;
@@ -1066,7 +1337,13 @@ void Manager::computeFlex(Solver &solver, int x, double phi) {
             std::sort(sortAgents[j].begin(), sortAgents[j].end(),
                       [](const auto &a, const auto &b) { return a.second > b.second; });
         }
-        computeAgentForTask(solver, j, sortAgents[j], phi, minBeta, minBetaTask, count);
+        size_t taskBudget = 0;
+        if (budgeted) {
+            auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+                    budgetEnd - std::chrono::steady_clock::now()).count();
+            taskBudget = std::max<size_t>(left > 0 ? (size_t) left / (sortTasks.size() - k) : 0, 1);
+        }
+        computeAgentForTask(solver, j, sortAgents[j], phi, minBeta, minBetaTask, count, false, taskBudget);
 //        }
 //        ++taskCalculated;
     }
@@ -1076,14 +1353,30 @@ void Manager::computeFlex(Solver &solver, int x, double phi) {
 //    }
 //    map->printOccupiedMap();
     std::cout << "calculate: " << count.calculate << ", skip: " << count.skip << ", step: " << count.step << std::endl;
-
+    if (skipFlag) {
+        // the new conflict free paths are indexed, the reused ones stay in the index
+        for (auto &agent : agents) {
+            for (auto &flexibility : agent.flexibility) {
+                if (flexibility.version == 0 && flexibility.conflictFree) indexPath(agent, flexibility);
+            }
+        }
+        stalePaths.clear();
+        map->setJournalEnabled(true);
+        std::cerr << "cached paths: " << checkedPathCount << " of " << cachedPathCount
+                  << " checked for conflicts" << std::endl;
+    }
+    if (flexBudget > 0) {
+        std::cerr << "flex budget: " << budgetUsedUpCount << " searches stopped, " << budgetDeferredCount
+                  << " tasks deferred" << (budgeted ? "" : " (no budget after a stalled pass)") << std::endl;
+    }
 }
 
-void Manager::printPaths() {
+void Manager::printPaths(Map *map) {
     for (size_t i = 0; i < agents.size(); i++) {
         std::cout << "agent " << i << " path" << std::endl;
         for (auto &p:agents[i].path) {
-            std::cout << p.pos.first << " " << p.pos.second << " " << p.leaveTime << std::endl;
+            auto pos = map->getPos(p.pos);
+            std::cout << pos.first << " " << pos.second << " " << p.leaveTime << std::endl;
         }
     }
 }
\ No newline at end of file
@@ -8,20 +8,25 @@
 #include "Map.h"
 #include "Scenario.h"
 #include "Solver.h"
+#include "AgentBounds.h"
+#include "ThreadPool.h"
 
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <list>
 #include <memory>
+#include <atomic>
 
 class Manager {
 public:
     struct PathNode {
-        std::pair<size_t, size_t> pos;
+        Map::CellId pos;
         size_t leaveTime;
     };
 
     struct Constraint {
-        std::pair<size_t, size_t> pos;
+        Map::CellId pos;
         Map::Direction direction;
         size_t start, end;
     };
@@ -40,6 +45,14 @@ public:
         std::vector<PathNode> path;
         Task *task;
         size_t occupiedAgent;
+        bool conflictFree = false;  // the path had no conflict when it was computed or last checked (-skip)
+        size_t version = 0;     // of the path in the path index, 0 if it is not indexed
+    };
+
+    // an indexed path passes through a cell in [startTime, endTime)
+    struct PathRef {
+        size_t version;
+        size_t startTime, endTime;
     };
 
     struct Agent {
@@ -57,6 +70,26 @@ public:
                 lastTimeStamp(that.lastTimeStamp), reservedPath(that.reservedPath) {}
     };
 
+    // the result of the searches of an agent for a task, see evaluateAgent
+    struct Evaluation {
+        bool evaluated = false;
+        size_t upperBound = 0;      // of the searches
+        std::vector<PathNode> path;
+        size_t agentStartTime = 0, agentEndTime = 0;    // agentEndTime is 0 if there is no path
+        size_t deliveryOccupiedAgent = 0;
+        size_t steps = 0;
+        bool released = true;       // false if the task is not released yet
+        bool conflictFree = false;  // see Flexibility
+        bool budgetUsedUp = false;  // a search is stopped by the budget, it is unknown whether there is a path
+        size_t lowerBound = 0;      // of agentEndTime if budgetUsedUp
+    };
+
+    // a worker evaluating the candidates of a task in parallel, the solvers of all workers search on the same map
+    // (with their own overlays)
+    struct FlexWorker {
+        std::unique_ptr<Solver> solver;
+    };
+
     struct Count {
         size_t step = 0;
         size_t skip = 0;
@@ -90,9 +123,43 @@ private:
     bool skipFlag;
     bool reserveNearestFlag;
     bool retryFlag;
+    Map::DistanceMode distanceMode = Map::DistanceMode::TABLE;
+    size_t distanceCacheSize = 1024 * 1024 * 1024;
+    ReservationTable::Backend reservationBackend = ReservationTable::Backend::DENSE;
+    size_t collectInterval = 0;
+    Solver::VirtualNodeOpenList::Backend openListBackend = Solver::VirtualNodeOpenList::Backend::MULTIMAP;
+    Solver::Heuristic heuristic = Solver::Heuristic::MANHATTAN;
+    size_t landmarkCount = 16;
+    size_t flexBudget = 0;              // of the searches in a computeFlex pass in microseconds (0: no budget)
+    std::atomic<size_t> budgetUsedUpCount{0};   // searches stopped by the budget in the current pass
+    size_t budgetDeferredCount = 0;     // tasks deferred to the next pass by the budget in the current pass
+    // the last pass deferred tasks and no task was assigned after it, the next pass has no budget (so it makes progress)
+    bool flexBudgetStalled = false;
+    // the cached flexibility paths by time bucket and cell (-skip), only the paths crossing an interval reserved
+    // since the last computeFlex are checked for conflicts, the refs of the discarded paths are left in the index
+    // (their versions are never looked up) until their buckets are before every agent
+    static constexpr size_t PATH_INDEX_BUCKET_BITS = 4;
+    std::map<size_t, std::unordered_map<Map::CellId, std::vector<PathRef> > > pathIndex;
+    size_t pathVersion = 0;
+    std::unordered_set<size_t> stalePaths;  // versions of the indexed paths crossing the new intervals
+    size_t cachedPathCount = 0, checkedPathCount = 0;   // in the current pass
+    AgentBounds agentBounds;    // of the agents and the task in computeAgentForTask
+    // the candidates of a task are evaluated in parallel in computeAgentForTask if flexThreads > 1,
+    // one worker for each thread of the pool and one for the thread waiting for it
+    size_t flexThreads = 1;
+    std::unique_ptr<ThreadPool> flexPool;
+    std::vector<FlexWorker> flexWorkers;
 
     void applyReservedPath();
 
+    // erase the reservations before the earliest time any agent can still act
+    void collectReservations(Map *map);
+
+    // the solver of the algorithm and the extra cost (0: closed) with the heuristic and the OPEN list backend
+    std::unique_ptr<Solver> createSolver(Map *map, int algorithm, int solverExtraCostId);
+
+    void createFlexWorkers(Map *map, int algorithm, int solverExtraCostId);
+
     void computeFlex(Solver &solver, int x, double phi);
 
     void selectTask(Solver &solver, int x, double phi);
@@ -105,18 +172,43 @@ private:
 
     void removeAgentPathConstraints(Map *map, Agent &agent, const std::vector<PathNode> &vector);
 
+    // mask the reservations of an agent (its parking location, infinite waiting and reserved path) in the overlay
+    // of the solver, the map is not changed
+    void maskAgentReservations(Solver &solver, Agent &agent);
+
     Map *loadMapFile(const std::string &filename);
     
     bool reservePath(Solver &solver, size_t i);
 
+    // returns the leave time at the goal (0 if no path is found) and the number of steps,
+    // a search is stopped after budget microseconds (0: no budget), then the leave time is 0 and lowerBound
+    // (if given) is set to the lower bound of the leave time, it is 0 if the search is not stopped by the budget
     std::pair<size_t, size_t> computePath(Solver &solver, std::vector<PathNode> &path, Scenario *task,
-                                          size_t startTime, size_t deadline);
+                                          size_t startTime, size_t deadline, size_t budget = 0,
+                                          size_t *lowerBound = nullptr);
 
+    // the searches of the candidates use the budget of the task (in microseconds, 0: no budget) in turn, an agent
+    // whose search is stopped by it (or not started) is evaluated again in the next pass, and the task is deferred
+    // (not failed) if no agent is found and a deferred agent may still finish it within the bound
     size_t computeAgentForTask(Solver &solver, size_t j, const std::vector<std::pair<size_t, double> > &sortAgent,
-                               double phi, double &minBeta, size_t &minBetaTask, Count &count, bool recalculate = false);
+                               double phi, double &minBeta, size_t &minBetaTask, Count &count, bool recalculate = false,
+                               size_t budget = 0);
+
+    // run the searches of agent i for task j on the map of the solver, the reservations of the agent are masked
+    // in the overlay of the solver, only the solver is changed (so it can run on a worker)
+    void evaluateAgent(Solver &solver, size_t i, size_t j, size_t upperBound, size_t budget, Evaluation &evaluation);
 
     bool isPathConflict(Solver &solver, Agent &agent, const std::vector<PathNode> &vector);
 
+    // add the cached path of an agent to the path index
+    void indexPath(const Agent &agent, Flexibility &flexibility);
+
+    // find the indexed paths crossing the intervals in the map journal (added since the last computeFlex)
+    void collectStalePaths(Map *map);
+
+    // isPathConflict for a cached path, only checked if the agent has moved or the path is not indexed or stale
+    bool isCachedPathConflict(Solver &solver, Agent &agent, const Flexibility &flexibility);
+
 public:
     explicit Manager(std::string dataPath, size_t maxStep = 10000, size_t windowSize = 0, int extraCostId = 0,
                      bool boundFlag = true, bool sortFlag = true,
@@ -125,6 +217,35 @@ public:
                      bool recalculateFlag = true, bool reserveAllFlag = true,
                      bool skipFlag = false, bool reserveNearestFlag = false, bool retryFlag = false);
 
+    // must be called before the maps are loaded
+    void setDistanceMode(Map::DistanceMode mode, size_t cacheSize) {
+        distanceMode = mode;
+        distanceCacheSize = cacheSize;
+    };
+
+    // must be called before the maps are loaded
+    void setReservationBackend(ReservationTable::Backend backend) { reservationBackend = backend; };
+
+    void setOpenListBackend(Solver::VirtualNodeOpenList::Backend backend) { openListBackend = backend; };
+
+    // the time budget in microseconds of each flexibility computation, divided among the tasks it still computes
+    // (0: no budget)
+    void setFlexBudget(size_t budget) { flexBudget = budget; };
+
+    // the number of threads evaluating the agents of a task in computeFlex (1: serial, 0: all hardware threads)
+    void setFlexThreads(size_t threads) {
+        flexThreads = threads > 0 ? threads : std::max<size_t>(1, std::thread::hardware_concurrency());
+    };
+
+    // collect the expired reservations every interval tasks (0 to disable)
+    void setCollectInterval(size_t interval) { collectInterval = interval; };
+
+    // must be called before the maps are loaded (the landmarks are selected when a map is loaded)
+    void setHeuristic(Solver::Heuristic _heuristic, size_t _landmarkCount = 16) {
+        heuristic = _heuristic;
+        landmarkCount = _landmarkCount;
+    };
+
     Map *getMap(const std::string &mapName);
 
     void loadScenarioFile(const std::string &filename);
@@ -137,7 +258,7 @@ public:
 
     void earliestDeadlineFirstAssign(Map *map, int algorithm, double phi);
 
-    void printPaths();
+    void printPaths(Map *map);
 };
 
 
@@ -4,6 +4,8 @@
 
 #include "Map.h"
 #include "Solver.h"
+#include "DistanceBuilder.h"
+#include "ThreadPool.h"
 
 #include <fstream>
 #include <sstream>
@@ -28,60 +30,427 @@ void Map::parseHeader(const std::string &line, const std::string &key, T &value)
     }
 }
 
-void Map::calculateDistances() {
-    size_t size = width * height;
-    distances.resize(size, std::vector<size_t>(size, std::numeric_limits<size_t>::max() / 2));
-    for (size_t i = 0; i < height; i++) {
-        for (size_t j = 0; j < width; j++) {
-            size_t a = i * width + j;
-            distances[a][a] = 0;
-            if (map[i][j] != '@') {
-                for (auto direction : Map::directions) {
-                    auto p = getPosByDirection({i, j}, direction);
-                    if (p.first && map[p.second.first][p.second.second] != '@') {
-                        size_t b = p.second.first * width + p.second.second;
-                        distances[a][b] = 1;
-                    }
-                }
-            }
-        }
-    }
-    for (size_t k = 0; k < size; k++) {
-        for (size_t i = 0; i < size; i++) {
-            for (size_t j = 0; j < size; j++) {
-                if (distances[i][j] > distances[i][k] + distances[k][j]) {
-                    distances[i][j] = distances[i][k] + distances[k][j];
-                }
-            }
-        }
-    }
+std::unique_ptr<DistanceTable> Map::calculateDistances(bool endpoint) {
+    ThreadPool pool;
+    DistanceBuilder builder(height, width, grid);
+    auto table = DistanceTable::create(traversableCells.size(), true);
+    builder.build(endpoint, traversableCells, *table, pool);
+    table->compact();
+    return table;
 }
 
 
-void Map::readDistances(const std::string &filename, std::vector<std::vector<size_t>> &result) {
-    size_t size = width * height;
+std::unique_ptr<DistanceTable> Map::readDistances(const std::string &filename) {
     std::istringstream iss;
     std::ifstream fin;
     std::string line;
 
-    result.resize(size, std::vector<size_t>(size, std::numeric_limits<size_t>::max() / 2));
     fin.open(filename);
     if (!fin.is_open()) {
         throw std::runtime_error("map distance file not found: " + filename);
     }
+    auto table = DistanceTable::create(traversableCells.size(), true);
     while (std::getline(fin, line)) {
         if (line.empty()) continue;
         iss.clear();
         iss.str(line);
         size_t x1, y1, x2, y2, distance;
         iss >> x1 >> y1 >> x2 >> y2 >> distance;
-        result[x1 * width + y1][x2 * width + y2] = distance;
+        if (x1 >= height || y1 >= width || x2 >= height || y2 >= width) {
+            throw std::runtime_error("map distance out of range: " + line);
+        }
+        size_t indexA = distanceIndex[getCellId({x1, y1})], indexB = distanceIndex[getCellId({x2, y2})];
+        // obstacles are not stored in the table
+        if (indexA >= traversableCells.size() || indexB >= traversableCells.size()) continue;
+        table->set(indexA, indexB, distance);
     }
     fin.close();
+    table->compact();
     std::cerr << "Map " << filename << " distances imported" << std::endl;
+    return table;
 }
 
-Map::Map(const std::string &filename) {
+void Map::loadDistances(const std::string &filename, std::unique_ptr<DistanceTable> &table, bool endpoint) {
+    auto header = DistanceTable::createHeader(mapHash, height, width, traversableCells.size());
+    auto binaryFilename = filename + ".bin";
+    table = DistanceTable::open(binaryFilename, header);
+    if (table) {
+        std::cerr << "Map " << binaryFilename << " distances mapped" << std::endl;
+        return;
+    }
+
+    std::ifstream fin(filename);
+    if (fin.is_open()) {
+        fin.close();
+        table = readDistances(filename);
+    } else {
+        std::cerr << "Map " << filename << " not found, calculating distances" << std::endl;
+        table = calculateDistances(endpoint);
+    }
+
+    // cache the table in the binary format so that the next runs can map it directly,
+    // keep the owned table if the cache can not be written
+    if (table->write(binaryFilename, header)) {
+        auto mapped = DistanceTable::open(binaryFilename, header);
+        if (mapped) {
+            table = std::move(mapped);
+            std::cerr << "Map " << binaryFilename << " distances cached" << std::endl;
+        }
+    }
+}
+
+size_t Map::getTableDistance(bool endpoint, CellId a, CellId b) const {
+    size_t indexA = distanceIndex[a], indexB = distanceIndex[b];
+    if (indexA >= traversableCells.size() || indexB >= traversableCells.size()) {
+        // obstacles are only connected to themselves
+        return a == b ? 0 : DistanceTable::INFINITE_DISTANCE;
+    }
+    if (distanceMode == DistanceMode::LAZY) {
+        return (endpoint ? distanceCacheEndpoint : distanceCache)->get(indexA, indexB);
+    }
+    return (endpoint ? distanceTableEndpoint : distanceTable)->get(indexA, indexB);
+}
+
+void Map::prewarmDistances(const std::vector<std::pair<size_t, size_t> > &cells) {
+    if (distanceMode != DistanceMode::LAZY) return;
+    std::vector<size_t> targets;
+    for (const auto &pos : cells) {
+        size_t index = distanceIndex[getCellId(pos)];
+        if (index < traversableCells.size()) {
+            targets.emplace_back(index);
+        }
+    }
+    ThreadPool pool;
+    distanceCache->prewarm(targets, pool);
+    distanceCacheEndpoint->prewarm(targets, pool);
+    std::cerr << "Map distances prewarmed: " << targets.size() << " targets" << std::endl;
+}
+
+void Map::printDistanceStats() const {
+    if (distanceMode != DistanceMode::LAZY) return;
+    auto stats = distanceCache->getStats();
+    auto statsEndpoint = distanceCacheEndpoint->getStats();
+    std::cerr << "Map distance cache: " << stats.hits + statsEndpoint.hits << " hits, "
+              << stats.misses + statsEndpoint.misses << " misses, "
+              << stats.evictions + statsEndpoint.evictions << " evictions" << std::endl;
+}
+
+void Map::initLandmarks(size_t count) {
+    if (!distanceBuilder) {
+        distanceBuilder = std::make_unique<DistanceBuilder>(height, width, grid);
+    }
+    std::vector<size_t> seeds;
+    for (const auto &pos : parkingLocations) {
+        seeds.emplace_back(distanceIndex[getCellId(pos)]);
+    }
+    landmarks = std::make_unique<Landmarks>(*distanceBuilder, traversableCells, count, seeds);
+    std::cerr << "Map landmarks: " << landmarks->size() << " landmarks, "
+              << landmarks->size() * traversableCells.size() * sizeof(uint32_t) / 1024 << " KiB" << std::endl;
+}
+
+size_t Map::getLandmarkDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end) const {
+    CellId a = getCellId(start), b = getCellId(end);
+    size_t indexA = distanceIndex[a], indexB = distanceIndex[b];
+    if (indexA >= traversableCells.size() || indexB >= traversableCells.size()) {
+        return a == b ? 0 : DistanceTable::INFINITE_DISTANCE;
+    }
+    return landmarks->getLowerBound(indexA, indexB);
+}
+
+void Map::buildNeighbors() {
+    neighborOffsets.assign(grid.size() + 1, 0);
+    neighbors.clear();
+    for (CellId id = 0; id < grid.size(); id++) {
+        neighborOffsets[id] = (uint32_t) neighbors.size();
+        // the cells on the border are obstacles, so the neighbors of the other cells always exist
+        if (grid[id] == '@') continue;
+        for (auto direction : directions) {
+            auto neighbor = getNeighbor(id, direction);
+            if (grid[neighbor] != '@') neighbors.push_back(Neighbor{neighbor, direction});
+        }
+    }
+    neighborOffsets[grid.size()] = (uint32_t) neighbors.size();
+}
+
+static size_t toTableDistance(uint32_t distance) {
+    return distance == DistanceBuilder::INFINITE_DISTANCE ? DistanceTable::INFINITE_DISTANCE : distance;
+}
+
+// whether a shortest path from source can step from one cell to a neighbor: with the endpoint distances a 't' cell
+// is only entered from a '.' cell as the end of a path and only left to a '.' cell as the source
+static bool canStep(bool endpoint, char from, bool fromSource, char to) {
+    if (from == '@' || to == '@') return false;
+    if (!endpoint) return true;
+    if (from == 't') return fromSource && to == '.';
+    return to != 't' || from == '.';
+}
+
+void Map::repairBlockedRow(const DistanceTable &table, bool endpoint, size_t source, CellId id, char cell,
+                           RowRepairBuffers &buffers, std::vector<std::pair<size_t, size_t> > &changes) const {
+    size_t cellCount = traversableCells.size();
+    CellId sourceId = getCellId({traversableCells[source] / width, traversableCells[source] % width});
+    if (buffers.affected.size() != grid.size()) {
+        buffers.affected.assign(grid.size(), 0);
+        buffers.checked.assign(grid.size(), 0);
+        buffers.expanded.assign(grid.size(), 0);
+        buffers.distances.assign(grid.size(), 0);
+    }
+    auto generation = ++buffers.generation;
+    auto isAffected = [&](CellId u) { return buffers.affected[u] == generation; };
+    auto getDistance = [&](CellId u) { return table.get(source, distanceIndex[u]); };
+
+    // the distances of the unaffected cells do not change, so a cell keeps its distance if a neighbor one step closer
+    // is not affected (the neighbors one step closer are decided before the cell, the cells are visited by distance)
+    auto hasParent = [&](CellId u) {
+        size_t distance = getDistance(u);
+        for (auto offset : directionOffsets) {
+            CellId parent = u + offset;
+            if (!isAffected(parent) && canStep(endpoint, grid[parent], parent == sourceId, grid[u]) &&
+                getDistance(parent) + 1 == distance) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // the affected cells lose all their shortest paths, they are the cells only reached through the blocked cell
+    // (the grid already has '@' there, so it is never a parent) and the cells only reached through affected cells
+    auto &affected = buffers.queue;
+    affected.clear();
+    size_t blockedDistance = table.get(source, distanceIndex[id]);
+    for (auto offset : directionOffsets) {
+        CellId child = id + offset;
+        if (isAffected(child) || !canStep(endpoint, cell, false, grid[child]) ||
+            getDistance(child) != blockedDistance + 1 || hasParent(child)) {
+            continue;
+        }
+        buffers.affected[child] = generation;
+        affected.emplace_back(child);
+    }
+    if (affected.empty()) return;
+    for (size_t head = 0; head < affected.size(); head++) {
+        CellId u = affected[head];
+        size_t distance = getDistance(u);
+        for (auto offset : directionOffsets) {
+            CellId child = u + offset;
+            if (isAffected(child) || buffers.checked[child] == generation ||
+                !canStep(endpoint, grid[u], false, grid[child]) || getDistance(child) != distance + 1) {
+                continue;
+            }
+            buffers.checked[child] = generation;
+            if (!hasParent(child)) {
+                buffers.affected[child] = generation;
+                affected.emplace_back(child);
+            }
+        }
+    }
+
+    if (affected.size() * 4 > cellCount) {
+        // most of the row changes, a BFS is faster than the repair
+        buffers.row.resize(distanceBuilder->size());
+        distanceBuilder->computeRow(traversableCells[source], endpoint, buffers.row.data(), buffers.rowQueue);
+        for (auto u : affected) {
+            size_t index = distanceIndex[u];
+            changes.emplace_back(index, toTableDistance(buffers.row[traversableCells[index]]));
+        }
+        return;
+    }
+
+    // the affected cells start from their unaffected neighbors and are relaxed in the order of distance,
+    // merging the sorted starts with the FIFO queue of the relaxed cells (all steps cost 1)
+    const auto infinite = (size_t) DistanceTable::INFINITE_DISTANCE;
+    auto &starts = buffers.starts;
+    starts.clear();
+    for (auto u : affected) {
+        size_t distance = infinite;
+        for (auto offset : directionOffsets) {
+            CellId parent = u + offset;
+            if (isAffected(parent) || !canStep(endpoint, grid[parent], parent == sourceId, grid[u])) continue;
+            size_t parentDistance = getDistance(parent);
+            if (parentDistance != infinite) distance = std::min(distance, parentDistance + 1);
+        }
+        buffers.distances[u] = distance;
+        if (distance != infinite) starts.emplace_back(distance, u);
+    }
+    std::sort(starts.begin(), starts.end());
+    auto &relaxed = buffers.relaxed;
+    relaxed.clear();
+    size_t startHead = 0, relaxedHead = 0;
+    while (startHead < starts.size() || relaxedHead < relaxed.size()) {
+        CellId u;
+        if (relaxedHead == relaxed.size() ||
+            (startHead < starts.size() && starts[startHead].first <= buffers.distances[relaxed[relaxedHead]])) {
+            u = starts[startHead++].second;
+        } else {
+            u = relaxed[relaxedHead++];
+        }
+        if (buffers.expanded[u] == generation) continue;
+        buffers.expanded[u] = generation;
+        size_t distance = buffers.distances[u] + 1;
+        for (auto offset : directionOffsets) {
+            CellId child = u + offset;
+            if (isAffected(child) && distance < buffers.distances[child] &&
+                canStep(endpoint, grid[u], false, grid[child])) {
+                buffers.distances[child] = distance;
+                relaxed.emplace_back(child);
+            }
+        }
+    }
+    for (auto u : affected) {
+        changes.emplace_back(distanceIndex[u], buffers.distances[u]);
+    }
+}
+
+size_t Map::repairBlockedDistances(DistanceTable &table, bool endpoint, CellId id, char cell) {
+    size_t cellCount = traversableCells.size(), index = distanceIndex[id];
+
+    // the rows are repaired in parallel into the lists of changes, which are written after all rows are done
+    // (a table entry may need a wider table), only the row of s is changed for a source s since the distances are
+    // symmetric: if d(s, t) changes then s is also affected in the row of t
+    // (a 't' cell is never crossed by an endpoint path, the other rows only lose its column)
+    std::vector<std::vector<std::pair<size_t, size_t> > > changes(cellCount);
+    if (!endpoint || cell != 't') {
+        if (!repairPool) repairPool = std::make_unique<ThreadPool>();
+        std::vector<RowRepairBuffers> buffers(repairPool->size() + 1);
+        repairPool->parallelFor(0, cellCount, 16, [&, this](size_t s) {
+            if (s == index || table.get(s, index) == DistanceTable::INFINITE_DISTANCE) return;
+            repairBlockedRow(table, endpoint, s, id, cell, buffers[repairPool->getWorkerIndex()], changes[s]);
+        });
+    }
+
+    size_t rows = 1;
+    for (size_t s = 0; s < cellCount; s++) {
+        for (const auto &change : changes[s]) {
+            table.set(s, change.first, change.second);
+        }
+        rows += !changes[s].empty();
+    }
+    for (size_t s = 0; s < cellCount; s++) {
+        table.set(s, index, DistanceTable::INFINITE_DISTANCE);
+        table.set(index, s, DistanceTable::INFINITE_DISTANCE);
+    }
+    table.set(index, index, 0);
+    return rows;
+}
+
+size_t Map::repairUnblockedDistances(DistanceTable &table, bool endpoint, CellId id, char cell) {
+    size_t cellCount = traversableCells.size(), index = distanceIndex[id];
+    std::vector<uint32_t> row(distanceBuilder->size()), queue;
+    distanceBuilder->computeRow(traversableCells[index], endpoint, row.data(), queue);
+    std::vector<size_t> distances(cellCount);
+    for (size_t t = 0; t < cellCount; t++) {
+        distances[t] = toTableDistance(row[traversableCells[t]]);
+    }
+    std::vector<size_t> neighborRows;
+    for (auto offset : directionOffsets) {
+        size_t neighbor = distanceIndex[id + offset];
+        if (neighbor < cellCount) neighborRows.emplace_back(neighbor);
+    }
+
+    // a new shortest path crosses the cell, so d'(s, t) = min(d(s, t), d'(s, c) + d'(c, t))
+    // (a 't' cell is never crossed by an endpoint path, only its own row and column change)
+    size_t rows = 1;
+    if (!endpoint || cell != 't') {
+        for (size_t s = 0; s < cellCount; s++) {
+            if (s == index || distances[s] == DistanceTable::INFINITE_DISTANCE) continue;
+            // a path from s through the cell enters it from a neighbor n1 and leaves it to a neighbor n2, so the
+            // row only changes if d(s, n1) + 2 < d(s, n2) for some neighbors (the distances without the cell)
+            size_t minDistance = DistanceTable::INFINITE_DISTANCE, maxDistance = 0;
+            for (auto neighbor : neighborRows) {
+                size_t distance = neighbor == s ? 0 : table.get(s, neighbor);
+                minDistance = std::min(minDistance, distance);
+                maxDistance = std::max(maxDistance, distance);
+            }
+            if (minDistance + 2 >= maxDistance) continue;
+            bool changed = false;
+            for (size_t t = 0; t < cellCount; t++) {
+                if (t == index || distances[t] == DistanceTable::INFINITE_DISTANCE) continue;
+                size_t distance = distances[s] + distances[t];
+                if (distance < table.get(s, t)) {
+                    table.set(s, t, distance);
+                    changed = true;
+                }
+            }
+            rows += changed;
+        }
+    }
+
+    for (size_t s = 0; s < cellCount; s++) {
+        table.set(s, index, distances[s]);
+        table.set(index, s, distances[s]);
+    }
+    return rows;
+}
+
+void Map::setBlocked(CellId id, bool blocked) {
+    if (distanceIndex[id] >= traversableCells.size()) {
+        throw std::runtime_error("only the traversable cells of the map can be blocked");
+    }
+    auto it = blockedCells.find(id);
+    if (blocked == (it != blockedCells.end())) return;
+    char cell;
+    if (blocked) {
+        cell = grid[id];
+        blockedCells.emplace(id, cell);
+        grid[id] = '@';
+    } else {
+        cell = it->second;
+        blockedCells.erase(it);
+        grid[id] = cell;
+    }
+    if (distanceBuilder) {
+        distanceBuilder->setCell(id, grid[id]);
+    } else {
+        distanceBuilder = std::make_unique<DistanceBuilder>(height, width, grid);
+    }
+    buildNeighbors();
+    ++topologyVersion;
+
+    size_t rows = 0;
+    if (distanceMode == DistanceMode::LAZY) {
+        // the rows are computed again on demand
+        distanceCache->clear();
+        distanceCacheEndpoint->clear();
+    } else {
+        // a mapped table is copied before it is changed, the binary cache keeps the distances of the map file
+        distanceTable->makeWritable();
+        distanceTableEndpoint->makeWritable();
+        auto repair = blocked ? &Map::repairBlockedDistances : &Map::repairUnblockedDistances;
+        rows = (this->*repair)(*distanceTable, false, id, cell) + (this->*repair)(*distanceTableEndpoint, true, id, cell);
+    }
+    if (landmarks) {
+        landmarks->update(*distanceBuilder, traversableCells);
+    }
+    auto pos = getPos(id);
+    std::cerr << "Map cell (" << pos.first << ", " << pos.second << ") " << (blocked ? "blocked" : "unblocked")
+              << ": " << rows << " distance rows repaired" << std::endl;
+}
+
+size_t Map::checkDistances() {
+    if (distanceMode == DistanceMode::LAZY) return 0;
+    if (!distanceBuilder) {
+        distanceBuilder = std::make_unique<DistanceBuilder>(height, width, grid);
+    }
+    size_t cellCount = traversableCells.size(), rows = 0;
+    std::vector<uint32_t> row(distanceBuilder->size()), queue;
+    for (auto endpoint : {false, true}) {
+        auto &table = endpoint ? *distanceTableEndpoint : *distanceTable;
+        for (size_t s = 0; s < cellCount; s++) {
+            distanceBuilder->computeRow(traversableCells[s], endpoint, row.data(), queue);
+            for (size_t t = 0; t < cellCount; t++) {
+                if (table.get(s, t) != toTableDistance(row[traversableCells[t]])) {
+                    ++rows;
+                    break;
+                }
+            }
+        }
+    }
+    return rows;
+}
+
+Map::Map(const std::string &filename, DistanceMode distanceMode, size_t distanceCacheSize,
+         ReservationTable::Backend reservationBackend)
+        : distanceMode(distanceMode) {
     std::ifstream fin(filename);
     if (!fin.is_open()) {
         throw std::runtime_error("map file not found");
@@ -112,30 +481,65 @@ Map::Map(const std::string &filename) {
     if (line != "map") {
         throw std::runtime_error("map format error");
     }
-    this->map.resize(this->height);
-    this->extraCost.resize(this->height);
+    this->stride = this->width + 2;
+    this->grid.assign((this->height + 2) * this->stride, '@');
+    this->extraCost.resize(this->grid.size(), false);
+    this->directionOffsets[(size_t) Direction::UP] = -(int) this->stride;
+    this->directionOffsets[(size_t) Direction::RIGHT] = 1;
+    this->directionOffsets[(size_t) Direction::DOWN] = (int) this->stride;
+    this->directionOffsets[(size_t) Direction::LEFT] = -1;
     for (size_t i = 0; i < this->height; i++) {
-        this->map[i].resize(this->width, '.');
-        this->extraCost[i].resize(this->width, false);
         if (!std::getline(fin, line) || line.length() < this->width) {
             throw std::runtime_error("map format error");
         }
         for (size_t j = 0; j < this->width; j++) {
-            this->map[i][j] = line[j];
-            if (this->map[i][j] == 'p') {
+            this->grid[getCellId({i, j})] = line[j];
+            if (line[j] == 'p') {
                 parkingLocations.emplace_back(i, j);
             }
         }
     }
     fin.close();
+    buildNeighbors();
+    reservations = std::make_unique<ReservationTable>(grid.size(), reservationBackend);
     std::cerr << "Map " << filename << " imported" << std::endl;
 
-    readDistances(filename + ".distance", distances);
-    readDistances(filename + ".endpoint.distance", distancesEndpoint);
-}
+    // index the traversable cells and hash the map to validate the binary distance tables
+    distanceIndex.resize(grid.size(), std::numeric_limits<size_t>::max());
+    mapHash = 14695981039346656037ull;
+    auto hash = [this](uint64_t value) {
+        mapHash = (mapHash ^ value) * 1099511628211ull;
+    };
+    hash(height);
+    hash(width);
+    for (size_t i = 0; i < height; i++) {
+        for (size_t j = 0; j < width; j++) {
+            auto id = getCellId({i, j});
+            hash((unsigned char) grid[id]);
+            if (grid[id] != '@') {
+                distanceIndex[id] = traversableCells.size();
+                traversableCells.emplace_back(i * width + j);
+            }
+        }
+    }
 
-const std::vector<char> &Map::operator[](size_t index) const {
-    return this->map[index];
+    if (distanceMode == DistanceMode::LAZY) {
+        // the budget is shared by the plain and the endpoint distances
+        distanceBuilder = std::make_unique<DistanceBuilder>(height, width, grid);
+        distanceCache = std::make_unique<DistanceCache>(
+                *distanceBuilder, traversableCells, false, distanceCacheSize / 2);
+        distanceCacheEndpoint = std::make_unique<DistanceCache>(
+                *distanceBuilder, traversableCells, true, distanceCacheSize / 2);
+        std::cerr << "Map distance cache: " << traversableCells.size() << " cells, "
+                  << distanceCache->getCapacity() << " rows" << std::endl;
+        prewarmDistances(parkingLocations);
+    } else {
+        loadDistances(filename + ".distance", distanceTable, false);
+        loadDistances(filename + ".endpoint.distance", distanceTableEndpoint, true);
+        std::cerr << "Map distance tables: " << traversableCells.size() << " cells, "
+                  << (distanceTable->getMemoryUsage() + distanceTableEndpoint->getMemoryUsage()) / 1024 << " KiB"
+                  << std::endl;
+    }
 }
 
 std::pair<bool, std::pair<size_t, size_t>>
@@ -147,21 +551,21 @@ Map::getPosByDirection(std::pair<size_t, size_t> pos, Direction direction) const
     return std::make_pair(flag, pos);
 }
 
-void Map::addNodeOccupied(std::pair<size_t, size_t> pos, size_t startTime, size_t endTime) {
+void Map::addNodeOccupied(CellId pos, size_t startTime, size_t endTime) {
     addEdgeOccupied(pos, Map::Direction::NONE, startTime, endTime);
 }
 
-void Map::removeNodeOccupied(std::pair<size_t, size_t> pos, size_t startTime, size_t endTime) {
+void Map::removeNodeOccupied(CellId pos, size_t startTime, size_t endTime) {
     removeEdgeOccupied(pos, Map::Direction::NONE, startTime, endTime);
 }
 
-static void addOccupied(std::pair<size_t, size_t> pos, Map::Direction direction,
-                        boost::icl::interval_set <size_t> &occupied,
-                        boost::icl::discrete_interval <size_t> &interval) {
+static void addOccupied(Map::CellId pos, Map::Direction direction,
+                        IntervalSet &occupied,
+                        Interval &interval) {
 /*    if (pos.first == 7 && pos.second == 5 && direction == Map::Direction::NONE) {
         std::cerr << "add " << interval << " to " << occupied << std::endl;
     }
-    if (boost::icl::intersects(occupied, interval)) {
+    if (intersects(occupied, interval)) {
         std::cerr << "add error: " << pos.first << " " << pos.second << " "
                   << occupied << " " << interval << std::endl;
         exit(0);
@@ -170,9 +574,9 @@ static void addOccupied(std::pair<size_t, size_t> pos, Map::Direction direction,
     occupied.add(interval);
 }
 
-static void removeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction,
-                           boost::icl::interval_set <size_t> &occupied,
-                           boost::icl::discrete_interval <size_t> &interval) {
+static void removeOccupied(Map::CellId pos, Map::Direction direction,
+                           IntervalSet &occupied,
+                           Interval &interval) {
 /*    if (!boost::icl::contains(occupied, interval)) {
         std::cerr << "remove error: " << pos.first << " " << pos.second << " "
                   << occupied << " " << interval << std::endl;
@@ -182,49 +586,50 @@ static void removeOccupied(std::pair<size_t, size_t> pos, Map::Direction directi
     occupied.subtract(interval);
 }
 
-size_t Map::addInfiniteWaiting(std::pair<size_t, size_t> pos, size_t startTime) {
-    extraCost[pos.first][pos.second] = startTime;
-    OccupiedKey key = {pos, Map::Direction::NONE};
+size_t Map::addInfiniteWaiting(CellId pos, size_t startTime) {
+    extraCost[pos] = startTime;
     size_t infinite = std::numeric_limits<size_t>::max() / 2;
     if (startTime == 0) {
-        auto it = occupiedMap.find(key);
-        if (it != occupiedMap.end()) {
-            auto occupied = &it->second->rangeConstraints;
+        auto slot = findReservation(pos, Map::Direction::NONE);
+        if (slot) {
+            auto occupied = &slot->rangeConstraints;
             if (!occupied->empty()) {
                 auto it2 = occupied->rbegin();
                 if (it2->upper() < infinite) {
                     startTime = it2->upper() + 1;
-                    auto interval = boost::icl::discrete_interval<size_t>(startTime, infinite);
+                    auto interval = Interval(startTime, infinite);
                     addOccupied(pos, Map::Direction::NONE, *occupied, interval);
-                    it->second->infiniteWaiting = startTime;
+                    if (journalEnabled) {
+                        occupiedJournal.emplace_back(OccupiedChange{pos, Map::Direction::NONE, startTime, infinite});
+                    }
+                    slot->infiniteWaiting = startTime;
                     return startTime;
                 }
             }
         }
     }
     addNodeOccupied(pos, startTime, infinite);
-    auto it = occupiedMap.find(key);
-    if (it != occupiedMap.end()) {
-        it->second->infiniteWaiting = startTime;
+    auto slot = findReservation(pos, Map::Direction::NONE);
+    if (slot) {
+        slot->infiniteWaiting = startTime;
     }
     return startTime;
 }
 
-size_t Map::removeInfiniteWaiting(std::pair<size_t, size_t> pos) {
-    extraCost[pos.first][pos.second] = std::numeric_limits<size_t>::max();
-    OccupiedKey key = {pos, Map::Direction::NONE};
+size_t Map::removeInfiniteWaiting(CellId pos) {
+    extraCost[pos] = std::numeric_limits<size_t>::max();
     size_t infinite = std::numeric_limits<size_t>::max() / 2;
-    auto it = occupiedMap.find(key);
-    if (it != occupiedMap.end()) {
-        auto occupied = &it->second->rangeConstraints;
+    auto slot = findReservation(pos, Map::Direction::NONE);
+    if (slot) {
+        auto occupied = &slot->rangeConstraints;
         if (!occupied->empty()) {
             auto it2 = occupied->rbegin();
             if (it2->upper() >= infinite) {
                 size_t result = it2->lower();
-                if (result < it->second->infiniteWaiting) {
-                    result = it->second->infiniteWaiting;
+                if (result < slot->infiniteWaiting) {
+                    result = slot->infiniteWaiting;
                 }
-                auto interval = boost::icl::discrete_interval<size_t>(result, it2->upper());
+                auto interval = Interval(result, it2->upper());
 //                    std::cerr << "infinite waiting error: " << it2->lower() << " " << it->second->infiniteWaiting << std::endl;
                 removeOccupied(pos, Map::Direction::NONE, *occupied, interval);
 //                occupied->subtract(interval);
@@ -236,63 +641,35 @@ size_t Map::removeInfiniteWaiting(std::pair<size_t, size_t> pos) {
     return infinite;
 }
 
-size_t Map::getExtraCostTime(std::pair<size_t, size_t> pos) {
-    return extraCost[pos.first][pos.second];
-}
-
-void Map::addEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime) {
+void Map::addEdgeOccupied(CellId pos, Map::Direction direction, size_t startTime, size_t endTime) {
     if (endTime <= startTime) return;
 
 //    if (pos.first == 15 && pos.second == 20 && startTime == 44) {
 //        std::cerr << startTime << " " << endTime << std::endl;
 //    }
 
-    if (direction == Map::Direction::LEFT) {
-        pos = getPosByDirection(pos, direction).second;
-        direction = Map::Direction::RIGHT;
-    } else if (direction == Map::Direction::UP) {
-        pos = getPosByDirection(pos, direction).second;
-        direction = Map::Direction::DOWN;
-    }
-
-    OccupiedKey key = {pos, direction};
-    auto interval = boost::icl::discrete_interval<size_t>(startTime, endTime);
-
-    auto it = occupiedMap.find(key);
-    if (it == occupiedMap.end()) {
-        auto occupied = std::make_unique<OccupiedValue>();
-        addOccupied(pos, direction, occupied->rangeConstraints, interval);
-        occupiedMap.emplace_hint(it, key, std::move(occupied));
-    } else {
-        auto occupied = it->second.get();
-//        if (boost::icl::intersects(occupied->rangeConstraints, interval)) {
-//            std::cerr << "add error: " << pos.first << " " << pos.second << " "
-//                      << occupied->rangeConstraints << " " << startTime << " " << endTime
-//                      << std::endl;
-//            exit(0);
-//        }
-        addOccupied(pos, direction, occupied->rangeConstraints, interval);
+    auto interval = Interval(startTime, endTime);
+    auto &slot = getReservation(pos, direction);
+//    if (intersects(slot.rangeConstraints, interval)) {
+//        std::cerr << "add error: " << pos.first << " " << pos.second << " "
+//                  << slot.rangeConstraints << " " << startTime << " " << endTime
+//                  << std::endl;
+//        exit(0);
+//    }
+    addOccupied(pos, direction, slot.rangeConstraints, interval);
+    if (journalEnabled) {
+        occupiedJournal.emplace_back(OccupiedChange{pos, direction, startTime, endTime});
     }
 }
 
-void Map::removeEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime,
-                             size_t endTime) {
+void Map::removeEdgeOccupied(CellId pos, Map::Direction direction, size_t startTime, size_t endTime) {
     if (endTime <= startTime) return;
 
-    if (direction == Map::Direction::LEFT) {
-        pos = getPosByDirection(pos, direction).second;
-        direction = Map::Direction::RIGHT;
-    } else if (direction == Map::Direction::UP) {
-        pos = getPosByDirection(pos, direction).second;
-        direction = Map::Direction::DOWN;
-    }
+    auto interval = Interval(startTime, endTime);
 
-    OccupiedKey key = {pos, direction};
-    auto interval = boost::icl::discrete_interval<size_t>(startTime, endTime);
-
-    auto it = occupiedMap.find(key);
-    if (it != occupiedMap.end()) {
-        auto &occupied = it->second->rangeConstraints;
+    auto slot = findReservation(pos, direction);
+    if (slot) {
+        auto &occupied = slot->rangeConstraints;
 //        if (!boost::icl::contains(occupied, interval)) {
 //            std::cerr << "remove error: " << pos.first << " " << pos.second << " "
 //                      << occupied << " " << startTime << " " << endTime << std::endl;
@@ -304,14 +681,8 @@ void Map::removeEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direc
     }
 }
 
-void Map::addWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_t agent) {
-    OccupiedKey key = {pos, Map::Direction::NONE};
-    auto it = occupiedMap.find(key);
-    if (it == occupiedMap.end()) {
-        auto occupied = std::make_unique<OccupiedValue>();
-        it = occupiedMap.emplace_hint(it, key, std::move(occupied));
-    }
-    auto &waitingAgents = it->second->waitingAgents;
+void Map::addWaitingAgent(CellId pos, size_t startTime, size_t agent) {
+    auto &waitingAgents = getReservation(pos, Map::Direction::NONE).waitingAgents;
     auto it2 = waitingAgents.find(startTime);
     if (it2 == waitingAgents.end()) {
         it2 = waitingAgents.emplace_hint(it2, startTime, agent);
@@ -329,14 +700,13 @@ void Map::addWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_
     }
 }
 
-void Map::removeWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_t agent) {
-    OccupiedKey key = {pos, Map::Direction::NONE};
-    auto it = occupiedMap.find(key);
-    if (it == occupiedMap.end()) {
+void Map::removeWaitingAgent(CellId pos, size_t startTime, size_t agent) {
+    auto slot = findReservation(pos, Map::Direction::NONE);
+    if (!slot) {
         std::cerr << "warning: removing non-exist waiting agent" << std::endl;
         return;
     }
-    auto &waitingAgents = it->second->waitingAgents;
+    auto &waitingAgents = slot->waitingAgents;
     auto it2 = waitingAgents.find(startTime);
     if (it2 == waitingAgents.end()) {
         std::cerr << "warning: removing non-exist waiting agent" << std::endl;
@@ -355,14 +725,13 @@ void Map::removeWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, si
     }
 }
 
-size_t Map::getLastWaitingAgent(std::pair<size_t, size_t> pos) {
+size_t Map::getLastWaitingAgent(CellId pos) const {
     constexpr size_t noAgent = std::numeric_limits<size_t>::max() / 2;
-    OccupiedKey key = {pos, Map::Direction::NONE};
-    auto it = occupiedMap.find(key);
-    if (it == occupiedMap.end()) {
+    auto slot = findReservation(pos, Map::Direction::NONE);
+    if (!slot) {
         return noAgent;
     }
-    auto &waitingAgents = it->second->waitingAgents;
+    auto &waitingAgents = slot->waitingAgents;
     if (waitingAgents.empty()) {
         return noAgent;
     }
@@ -400,13 +769,25 @@ Map::Direction Map::getDirectionByPos(std::pair<size_t, size_t> pos1, std::pair<
     return Direction::NONE;
 }
 
+ReservationTable::Slot &Map::getReservation(CellId id, Direction direction) {
+    auto key = getReservationKey(id, direction);
+    return reservations->get(key.first, key.second);
+}
+
+Map::Direction Map::getDirectionByCell(CellId id1, CellId id2) const {
+    for (auto direction : directions) {
+        if (getNeighbor(id1, direction) == id2) return direction;
+    }
+    return Direction::NONE;
+}
+
 void Map::printOccupied(std::map<size_t, size_t> *occupied) {
     for (auto item : *occupied) {
         std::cerr << "[" << item.first << "," << item.second << ") ";
     }
 }
 
-void Map::printOccupied(boost::icl::interval_set <size_t> *occupied) {
+void Map::printOccupied(IntervalSet *occupied) {
     if (occupied) {
         std::cerr << *occupied;
 //        for (auto item : *occupied) {
@@ -418,10 +799,13 @@ void Map::printOccupied(boost::icl::interval_set <size_t> *occupied) {
 
 std::string Map::printOccupiedMap() const {
     std::ostringstream oss;
-    for (auto it = occupiedMap.begin(); it != occupiedMap.end(); ++it) {
-        oss << it->first.pos.first << " " << it->first.pos.second << " " << (int) it->first.direction << ": ";
-        oss << it->second->rangeConstraints << std::endl;
-    }
+    reservations->forEach([&](size_t id, ReservationTable::SlotType type, const ReservationTable::Slot &slot) {
+        auto pos = getPos(id);
+        auto direction = type == ReservationTable::SlotType::VERTEX ? Direction::NONE :
+                         type == ReservationTable::SlotType::RIGHT ? Direction::RIGHT : Direction::DOWN;
+        oss << pos.first << " " << pos.second << " " << (int) direction << ": ";
+        oss << slot.rangeConstraints << std::endl;
+    });
     return oss.str();
 }
 
@@ -434,19 +818,21 @@ size_t Map::getDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_
     return distance;
 }
 
-size_t Map::getGraphDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end) {
-    size_t a = start.first * width + start.second;
-    size_t b = end.first * width + end.second;
-    return distances[a][b];
-}
-
-size_t Map::getGraphDistanceEndpoint(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end) {
-    size_t a = start.first * width + start.second;
-    size_t b = end.first * width + end.second;
-    return distancesEndpoint[a][b];
+Map::DistanceRow Map::getGraphDistanceRow(CellId end) const {
+    DistanceRow row;
+    row.target = distanceIndex[end];
+    if (distanceMode == DistanceMode::LAZY) {
+        row.distances = distanceCache->getRow(row.target);
+    } else {
+        row.table = distanceTable.get();
+    }
+    return row;
 }
 
-bool Map::isParkingLocation(std::pair<size_t, size_t> pos) const {
-    assert(pos.first < height && pos.second < width);
-    return map[pos.first][pos.second] == 'p';
+void Map::getGraphDistancesEndpoint(CellId end, const std::vector<CellId> &cells, uint32_t *distances) const {
+    for (size_t k = 0; k < cells.size(); k++) {
+        auto distance = getTableDistance(true, end, cells[k]);
+        distances[k] = distance < DistanceBuilder::INFINITE_DISTANCE ? (uint32_t) distance
+                                                                     : DistanceBuilder::INFINITE_DISTANCE;
+    }
 }
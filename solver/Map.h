@@ -9,10 +9,14 @@
 #include <vector>
 #include <memory>
 #include <map>
-#include <unordered_map>
+#include <cstdint>
 
-#include <boost/icl/discrete_interval.hpp>
-#include <boost/icl/interval_set.hpp>
+#include "IntervalSet.h"
+#include "DistanceTable.h"
+#include "DistanceCache.h"
+#include "Landmarks.h"
+#include "ReservationTable.h"
+#include "ThreadPool.h"
 
 class Map {
 public:
@@ -20,106 +24,312 @@ public:
         UP, RIGHT, DOWN, LEFT, NONE
     };
 
-    static const Direction directions[4];
-    static const int DIRECTION_X[4];
-    static const int DIRECTION_Y[4];
+    enum class DistanceMode {
+        TABLE,  // all-pairs tables loaded from (or cached to) the distance files
+        LAZY    // BFS rows computed on demand and kept in an LRU cache
+    };
+
+    // a cell (x, y) is identified by (x + 1) * stride + y + 1 in a row-major grid of (height + 2) x (width + 2),
+    // the border is filled with '@', so the neighbors of a traversable cell are id -+ stride and id +- 1
+    typedef uint32_t CellId;
 
-    struct OccupiedKey {
-        std::pair<size_t, size_t> pos;
-        Map::Direction direction;
+    // a traversable neighbor of a cell and the direction to it
+    struct Neighbor {
+        CellId id;
+        Direction direction;
     };
 
-    struct OccupiedKeyHash {
-        size_t operator()(OccupiedKey const &occupiedKey) const noexcept {
-            auto hash = std::hash<std::size_t>{};
-            return hash(occupiedKey.pos.first) ^ (hash(occupiedKey.pos.second) << 1) ^
-                   (hash(size_t(occupiedKey.direction)) << 2);
-        }
+    struct NeighborRange {
+        const Neighbor *first, *last;
+
+        const Neighbor *begin() const { return first; };
+
+        const Neighbor *end() const { return last; };
     };
 
-    struct OccupiedKeyEqual {
-        constexpr bool operator()(const OccupiedKey &a, const OccupiedKey &b) const {
-            return a.pos == b.pos && a.direction == b.direction;
-        }
+    // the graph distances from the traversable cells (indexed by getDistanceIndex) to a cell, read from the distance
+    // table or shared with the distance cache (in the lazy mode), so a solver does not keep its own copy
+    struct DistanceRow {
+        const DistanceTable *table = nullptr;
+        size_t target = 0;      // the row in the table
+        std::shared_ptr<const std::vector<uint32_t> > distances;   // the row in the cache if there is no table
+
+        // DistanceTable::INFINITE_DISTANCE if unreachable
+        size_t get(size_t index) const {
+            if (table) return table->get(target, index);
+            auto distance = (*distances)[index];
+            return distance == DistanceBuilder::INFINITE_DISTANCE ? DistanceTable::INFINITE_DISTANCE : distance;
+        };
     };
 
-    struct OccupiedValue {
-        boost::icl::interval_set<size_t> rangeConstraints;
-        size_t infiniteWaiting = 0;
-        std::map<size_t, size_t> waitingAgents;
+    // an occupied interval added to a vertex (NONE) or an edge
+    struct OccupiedChange {
+        CellId id;
+        Direction direction;
+        size_t startTime, endTime;
     };
 
+    static const Direction directions[4];
+    static const int DIRECTION_X[4];
+    static const int DIRECTION_Y[4];
+
 private:
-    size_t height = 0, width = 0;
+    size_t height = 0, width = 0, stride = 0;
     std::string type;
-    std::vector<std::vector<char> > map;
-    std::vector<std::vector<size_t> > distances;
-    std::vector<std::vector<size_t> > distancesEndpoint;
+    std::vector<char> grid;
+    int directionOffsets[4];
+    std::vector<uint32_t> neighborOffsets;  // cell id -> first of its neighbors, getCellCount() + 1 entries
+    std::vector<Neighbor> neighbors;        // the traversable neighbors of all cells (CSR)
+    std::unique_ptr<DistanceTable> distanceTable;
+    std::unique_ptr<DistanceTable> distanceTableEndpoint;
+    DistanceMode distanceMode;
+    std::unique_ptr<DistanceBuilder> distanceBuilder;
+    std::unique_ptr<DistanceCache> distanceCache;
+    std::unique_ptr<DistanceCache> distanceCacheEndpoint;
+    std::unique_ptr<Landmarks> landmarks;
+    std::unique_ptr<ThreadPool> repairPool;     // repairs the distance rows after a cell is blocked
+    std::vector<size_t> distanceIndex;      // cell id -> row in the distance tables
+    std::vector<size_t> traversableCells;   // row in the distance tables -> x * width + y
+    uint64_t mapHash = 0;
+    std::map<CellId, char> blockedCells;    // cells blocked at runtime -> the cell in the map file
+    size_t topologyVersion = 0;             // increased when a cell is blocked or unblocked
     std::vector<std::pair<size_t, size_t>> parkingLocations;
-    std::vector<std::vector<size_t> > extraCost;
+    std::vector<size_t> extraCost;
+
+    std::unique_ptr<ReservationTable> reservations;
+    bool journalEnabled = false;
+    std::vector<OccupiedChange> occupiedJournal;    // the intervals added while the journal is enabled
 
-    std::unordered_map<OccupiedKey, std::unique_ptr<OccupiedValue>, OccupiedKeyHash, OccupiedKeyEqual> occupiedMap;
 
+    // build the neighbors of the traversable cells, again when a cell is blocked or unblocked
+    void buildNeighbors();
 
     template<typename T>
     static void parseHeader(const std::string &line, const std::string &key, T &value);
 
-    void calculateDistances();
+    std::unique_ptr<DistanceTable> calculateDistances(bool endpoint);
+
+    std::unique_ptr<DistanceTable> readDistances(const std::string &filename);
+
+    // map the binary cache of a distance table, create it from the text table (or calculate it) if needed
+    void loadDistances(const std::string &filename, std::unique_ptr<DistanceTable> &table, bool endpoint);
+
+    size_t getTableDistance(bool endpoint, CellId a, CellId b) const;
+
+    // repair a distance table after the cell (traversable as cell in the map file) is blocked or unblocked,
+    // return the number of rows changed
+    size_t repairBlockedDistances(DistanceTable &table, bool endpoint, CellId id, char cell);
+
+    // the buffers of the repair of a distance row, one per thread, the marks are valid for the current generation
+    struct RowRepairBuffers {
+        std::vector<uint32_t> affected, checked, expanded;  // cell id -> generation
+        std::vector<size_t> distances;                      // cell id -> new distance of an affected cell
+        std::vector<CellId> queue, relaxed;
+        std::vector<std::pair<size_t, CellId> > starts;
+        std::vector<uint32_t> row, rowQueue;                // a BFS row if most of the row changes
+        uint32_t generation = 0;
+    };
+
+    // find the cells of the row of source whose shortest paths all cross the blocked cell and compute their new
+    // distances from the unaffected cells around them (Ramalingam-Reps), the changes are appended
+    void repairBlockedRow(const DistanceTable &table, bool endpoint, size_t source, CellId id, char cell,
+                          RowRepairBuffers &buffers, std::vector<std::pair<size_t, size_t> > &changes) const;
 
-    void readDistances(const std::string &filename, std::vector<std::vector<size_t> > &distances);
+    size_t repairUnblockedDistances(DistanceTable &table, bool endpoint, CellId id, char cell);
 
 public:
-    explicit Map(const std::string &filename);
+    explicit Map(const std::string &filename, DistanceMode distanceMode = DistanceMode::TABLE,
+                 size_t distanceCacheSize = 1024 * 1024 * 1024,
+                 ReservationTable::Backend reservationBackend = ReservationTable::Backend::DENSE);
+
+    auto getDistanceMode() const { return this->distanceMode; };
+
+    // compute the distance rows to the given cells in parallel (only in the lazy mode)
+    void prewarmDistances(const std::vector<std::pair<size_t, size_t> > &cells);
+
+    void printDistanceStats() const;
+
+    // select the landmarks and compute their distances, see Landmarks
+    void initLandmarks(size_t count);
+
+    auto getLandmarks() const { return this->landmarks.get(); };
+
+    // row of a cell in the distance tables and landmarks, max if it is an obstacle
+    auto getDistanceIndex(CellId id) const { return this->distanceIndex[id]; };
+
+    auto getDistanceIndex(std::pair<size_t, size_t> pos) const { return getDistanceIndex(getCellId(pos)); };
+
+    // landmark lower bound of the graph distance (also of the endpoint distance)
+    size_t getLandmarkDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end) const;
+
+    // block a cell ('@') or restore it at runtime, only the cells traversable in the map file can be changed,
+    // the distance tables (or the cached rows in the lazy mode) and the landmarks are repaired incrementally
+    void setBlocked(CellId id, bool blocked);
+
+    void setBlocked(std::pair<size_t, size_t> pos, bool blocked) { setBlocked(getCellId(pos), blocked); };
+
+    bool isBlocked(CellId id) const { return this->blockedCells.count(id) > 0; };
+
+    // compare the distance tables with the BFS rows of the current grid (a self-check of the repairs of setBlocked),
+    // return the number of rows that differ (0 in the lazy mode, the cached rows are computed from the current grid)
+    size_t checkDistances();
+
+    // changed whenever the traversable cells change, so that the users can drop what they derived from them
+    auto getTopologyVersion() const { return this->topologyVersion; };
 
     auto getHeight() const { return this->height; };
 
     auto getWidth() const { return this->width; };
 
-    const std::vector<char> &operator[](size_t index) const;
+    auto getStride() const { return this->stride; };
+
+    // number of cell ids (including the border)
+    auto getCellCount() const { return this->grid.size(); };
+
+    CellId getCellId(std::pair<size_t, size_t> pos) const { return (pos.first + 1) * stride + pos.second + 1; };
+
+    std::pair<size_t, size_t> getPos(CellId id) const { return {id / stride - 1, id % stride - 1}; };
+
+    char getCell(CellId id) const { return this->grid[id]; };
+
+    // the neighbor of a cell that is not on the border
+    CellId getNeighbor(CellId id, Direction direction) const { return id + directionOffsets[(size_t) direction]; };
+
+    auto getDirectionOffsets() const { return this->directionOffsets; };
+
+    // the traversable neighbors of a cell in the order of directions (none for an obstacle)
+    NeighborRange getNeighbors(CellId id) const {
+        return {neighbors.data() + neighborOffsets[id], neighbors.data() + neighborOffsets[id + 1]};
+    };
+
+    // row x of the map (without the border)
+    const char *operator[](size_t x) const { return this->grid.data() + (x + 1) * stride + 1; };
 
     std::pair<bool, std::pair<size_t, size_t>> getPosByDirection(std::pair<size_t, size_t> pos, Direction direction) const;
 
     Direction getDirectionByPos(std::pair<size_t, size_t> pos1, std::pair<size_t, size_t> pos2) const;
 
-    void addNodeOccupied(std::pair<size_t, size_t> pos, size_t startTime, size_t endTime);
+    Direction getDirectionByCell(CellId id1, CellId id2) const;
+
+    void addNodeOccupied(CellId id, size_t startTime, size_t endTime);
+
+    void removeNodeOccupied(CellId id, size_t startTime, size_t endTime);
 
-    void removeNodeOccupied(std::pair<size_t, size_t> pos, size_t startTime, size_t endTime);
+    size_t addInfiniteWaiting(CellId id, size_t startTime = 0);
 
-    size_t addInfiniteWaiting(std::pair<size_t, size_t> pos, size_t startTime = 0);
+    size_t removeInfiniteWaiting(CellId id);
 
-    size_t removeInfiniteWaiting(std::pair<size_t, size_t> pos);
+    size_t getExtraCostTime(CellId id) const { return this->extraCost[id]; };
 
-    size_t getExtraCostTime(std::pair<size_t, size_t> pos);
+    void addEdgeOccupied(CellId id, Map::Direction direction, size_t startTime, size_t endTime);
 
-    void addEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime);
+    void removeEdgeOccupied(CellId id, Map::Direction direction, size_t startTime, size_t endTime);
 
-    void removeEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime);
+    void addWaitingAgent(CellId id, size_t startTime, size_t agent);
 
-    void addWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_t agent);
+    void removeWaitingAgent(CellId id, size_t startTime, size_t agent);
 
-    void removeWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_t agent);
+    size_t getLastWaitingAgent(CellId id) const;
 
-    size_t getLastWaitingAgent(std::pair<size_t, size_t> pos);
+    void addNodeOccupied(std::pair<size_t, size_t> pos, size_t startTime, size_t endTime) {
+        addNodeOccupied(getCellId(pos), startTime, endTime);
+    };
+
+    void removeNodeOccupied(std::pair<size_t, size_t> pos, size_t startTime, size_t endTime) {
+        removeNodeOccupied(getCellId(pos), startTime, endTime);
+    };
+
+    size_t addInfiniteWaiting(std::pair<size_t, size_t> pos, size_t startTime = 0) {
+        return addInfiniteWaiting(getCellId(pos), startTime);
+    };
+
+    size_t removeInfiniteWaiting(std::pair<size_t, size_t> pos) { return removeInfiniteWaiting(getCellId(pos)); };
+
+    size_t getExtraCostTime(std::pair<size_t, size_t> pos) const { return getExtraCostTime(getCellId(pos)); };
+
+    void addEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime) {
+        addEdgeOccupied(getCellId(pos), direction, startTime, endTime);
+    };
+
+    void removeEdgeOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime) {
+        removeEdgeOccupied(getCellId(pos), direction, startTime, endTime);
+    };
+
+    void addWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_t agent) {
+        addWaitingAgent(getCellId(pos), startTime, agent);
+    };
+
+    void removeWaitingAgent(std::pair<size_t, size_t> pos, size_t startTime, size_t agent) {
+        removeWaitingAgent(getCellId(pos), startTime, agent);
+    };
+
+    size_t getLastWaitingAgent(std::pair<size_t, size_t> pos) const { return getLastWaitingAgent(getCellId(pos)); };
 
     bool loadConstraints(const std::string &filename);
 
-    auto &getOccupiedMap() const { return this->occupiedMap; };
+    auto &getReservations() const { return *this->reservations; };
+
+    // record the occupied intervals added from now on (the removed ones are not recorded),
+    // see Manager::computeFlex
+    void setJournalEnabled(bool flag) { journalEnabled = flag; };
+
+    auto &getOccupiedJournal() const { return this->occupiedJournal; };
+
+    void clearOccupiedJournal() { occupiedJournal.clear(); };
+
+    // erase the occupied intervals that end before the watermark, see ReservationTable::collect
+    ReservationTable::CollectStats collectReservations(size_t watermark) { return reservations->collect(watermark); };
+
+    // the reservation slot of a vertex (NONE) or an edge, nullptr if there is none,
+    // the edges to the left and up are stored on the neighbor, so the cell must not be on the border
+    ReservationTable::Slot *findReservation(CellId id, Direction direction) const {
+        auto key = getReservationKey(id, direction);
+        return reservations->find(key.first, key.second);
+    };
+
+    // the cell and the type of the slot that holds the reservations of a vertex (NONE) or an edge
+    std::pair<CellId, ReservationTable::SlotType> getReservationKey(CellId id, Direction direction) const {
+        if (direction == Direction::NONE) return {id, ReservationTable::SlotType::VERTEX};
+        if (direction == Direction::LEFT || direction == Direction::UP) id = getNeighbor(id, direction);
+        return {id, direction == Direction::LEFT || direction == Direction::RIGHT ?
+                    ReservationTable::SlotType::RIGHT : ReservationTable::SlotType::DOWN};
+    };
+
+    ReservationTable::Slot &getReservation(CellId id, Direction direction);
 
     static void printOccupied(std::map<size_t, size_t> *occupied);
 
-    static void printOccupied(boost::icl::interval_set<size_t> *occupied);
+    static void printOccupied(IntervalSet *occupied);
 
     std::string printOccupiedMap() const;
 
     static size_t getDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end);
 
-    size_t getGraphDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end);
+    size_t getGraphDistance(CellId start, CellId end) const { return getTableDistance(false, start, end); };
 
-    size_t getGraphDistanceEndpoint(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end);
+    size_t getGraphDistanceEndpoint(CellId start, CellId end) const { return getTableDistance(true, start, end); };
+
+    size_t getGraphDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end) const {
+        return getGraphDistance(getCellId(start), getCellId(end));
+    };
+
+    size_t getGraphDistanceEndpoint(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end) const {
+        return getGraphDistanceEndpoint(getCellId(start), getCellId(end));
+    };
+
+    // graph distances from the traversable cells to end (a traversable cell), the graph is undirected so the row of
+    // end is read, a table row changes with the table when a cell is blocked or unblocked, a cached row does not
+    DistanceRow getGraphDistanceRow(CellId end) const;
+
+    // endpoint distances from the cells to end, DistanceBuilder::INFINITE_DISTANCE if unreachable,
+    // the row of end is read instead of the column (the graph is undirected), see Manager::computeAgentForTask
+    void getGraphDistancesEndpoint(CellId end, const std::vector<CellId> &cells, uint32_t *distances) const;
 
     auto &getParkingLocations() const { return this->parkingLocations; };
 
-    bool isParkingLocation(std::pair<size_t, size_t> pos) const;
+    bool isParkingLocation(CellId id) const { return this->grid[id] == 'p'; };
+
+    bool isParkingLocation(std::pair<size_t, size_t> pos) const { return isParkingLocation(getCellId(pos)); };
 };
 
 
@@ -0,0 +1,285 @@
+#ifndef MAPF_OPENLIST_H
+#define MAPF_OPENLIST_H
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+// The OPEN list of the solver, the nodes are ordered by (estimateTime, extraCost) and by insertion if they are equal
+// with an extra cost window w > 1, the nodes whose estimateTime are in the same window are ordered by extraCost first,
+// the key is (estimateTime / w, extraCost * w + estimateTime % w), so that it is still a strict weak ordering
+//
+// the backends pop the nodes in the same order (so the searches are the same):
+//   MULTIMAP: std::multimap, erase scans the nodes with the same key
+//   HEAP: indexed 4-ary heap, O(log n) push, pop and erase
+//   BUCKET: two-level bucket queue indexed by the key, O(1) push and erase, pop skips the empty buckets
+// the position of a node in the heap or in its bucket is kept in node->openIndex,
+// the key of a node must not change while it is in the list
+template<typename Node>
+class OpenList {
+public:
+    enum class Backend {
+        MULTIMAP, HEAP, BUCKET
+    };
+
+    typedef std::pair<size_t, size_t> Key;
+
+private:
+    struct HeapEntry {
+        Key key;
+        uint64_t sequence;
+        Node *node;
+
+        bool operator<(const HeapEntry &that) const {
+            return key < that.key || (key == that.key && sequence < that.sequence);
+        };
+    };
+
+    // nodes in insertion order, the erased ones are nullptr
+    struct Bucket {
+        std::vector<Node *> nodes;
+        size_t head = 0, count = 0;
+    };
+
+    struct Level {
+        std::vector<Bucket> buckets;
+        size_t first = 0, count = 0;    // first may point to an empty bucket before the first node
+    };
+
+    static constexpr size_t ARITY = 4;
+
+    Backend backend;
+    size_t window;
+    size_t count = 0;
+
+    std::multimap<Key, Node *> multimap;
+
+    std::vector<HeapEntry> heap;
+    uint64_t sequence = 0;
+
+    std::vector<Level> levels;
+    size_t firstLevel = 0;                  // may point to an empty level before the first node
+    size_t touchedBegin = 0, touchedEnd = 0;    // levels used since the last clear
+
+    void place(size_t i, const HeapEntry &entry) {
+        heap[i] = entry;
+        entry.node->openIndex = (uint32_t) i;
+    };
+
+    void siftUp(size_t i) {
+        auto entry = heap[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / ARITY;
+            if (!(entry < heap[parent])) break;
+            place(i, heap[parent]);
+            i = parent;
+        }
+        place(i, entry);
+    };
+
+    void siftDown(size_t i) {
+        auto entry = heap[i];
+        while (true) {
+            size_t first = i * ARITY + 1;
+            if (first >= heap.size()) break;
+            size_t best = first;
+            for (size_t child = first + 1; child < std::min(first + ARITY, heap.size()); child++) {
+                if (heap[child] < heap[best]) best = child;
+            }
+            if (!(heap[best] < entry)) break;
+            place(i, heap[best]);
+            i = best;
+        }
+        place(i, entry);
+    };
+
+    // remove the node at position index of its bucket
+    void removeFromBucket(const Key &key, size_t index) {
+        auto &level = levels[key.first];
+        auto &bucket = level.buckets[key.second];
+        bucket.nodes[index] = nullptr;
+        --level.count;
+        if (--bucket.count == 0) {
+            bucket.nodes.clear();
+            bucket.head = 0;
+        }
+    };
+
+public:
+    explicit OpenList(Backend backend = Backend::MULTIMAP, size_t extraCostWindow = 0)
+            : backend(backend), window(std::max<size_t>(extraCostWindow, 1)) {}
+
+    auto getBackend() const { return this->backend; };
+
+    bool empty() const { return count == 0; };
+
+    size_t size() const { return count; };
+
+    // the key of a node, without the extra cost (plain ordering) the window is 1 and the extra cost is 0,
+    // so the plain key needs no division
+    template<bool ExtraCost = true>
+    Key getKey(const Node *node) const {
+        if constexpr (ExtraCost) {
+            return {node->estimateTime / window, node->extraCost * window + node->estimateTime % window};
+        } else {
+            return {node->estimateTime, node->extraCost};
+        }
+    };
+
+    // the operations with the backend and the ordering as template arguments are used in the search loop
+    // (see SolverT::search), so that it does not branch on them, the others dispatch on the backend of the list
+
+    template<Backend B, bool ExtraCost>
+    void push(Node *node) {
+        auto key = getKey<ExtraCost>(node);
+        if constexpr (B == Backend::MULTIMAP) {
+            multimap.emplace(key, node);
+        } else if constexpr (B == Backend::HEAP) {
+            heap.push_back(HeapEntry{key, sequence++, node});
+            siftUp(heap.size() - 1);
+        } else {
+            if (key.first >= levels.size()) levels.resize(key.first + 1);
+            auto &level = levels[key.first];
+            if (key.second >= level.buckets.size()) level.buckets.resize(key.second + 1);
+            auto &bucket = level.buckets[key.second];
+            node->openIndex = (uint32_t) bucket.nodes.size();
+            bucket.nodes.push_back(node);
+            ++bucket.count;
+            level.first = level.count++ == 0 ? key.second : std::min(level.first, key.second);
+            firstLevel = count == 0 ? key.first : std::min(firstLevel, key.first);
+            if (touchedBegin == touchedEnd) {
+                touchedBegin = key.first;
+                touchedEnd = key.first + 1;
+            } else {
+                touchedBegin = std::min(touchedBegin, key.first);
+                touchedEnd = std::max(touchedEnd, key.first + 1);
+            }
+        }
+        ++count;
+    };
+
+    void push(Node *node) {
+        if (backend == Backend::MULTIMAP) push<Backend::MULTIMAP, true>(node);
+        else if (backend == Backend::HEAP) push<Backend::HEAP, true>(node);
+        else push<Backend::BUCKET, true>(node);
+    };
+
+    // no node in the list has a smaller estimateTime, the list must not be empty
+    size_t getLowerBound() {
+        return getKey(top()).first * window;
+    };
+
+    // the first node, the list must not be empty
+    template<Backend B>
+    Node *top() {
+        if constexpr (B == Backend::MULTIMAP) {
+            return multimap.begin()->second;
+        } else if constexpr (B == Backend::HEAP) {
+            return heap.front().node;
+        } else {
+            while (levels[firstLevel].count == 0) ++firstLevel;
+            auto &level = levels[firstLevel];
+            while (level.buckets[level.first].count == 0) ++level.first;
+            auto &bucket = level.buckets[level.first];
+            while (!bucket.nodes[bucket.head]) ++bucket.head;
+            return bucket.nodes[bucket.head];
+        }
+    };
+
+    Node *top() {
+        if (backend == Backend::MULTIMAP) return top<Backend::MULTIMAP>();
+        if (backend == Backend::HEAP) return top<Backend::HEAP>();
+        return top<Backend::BUCKET>();
+    };
+
+    template<Backend B>
+    Node *pop() {
+        auto node = top<B>();
+        if constexpr (B == Backend::MULTIMAP) {
+            multimap.erase(multimap.begin());
+        } else if constexpr (B == Backend::HEAP) {
+            heap.front() = heap.back();
+            heap.pop_back();
+            if (!heap.empty()) siftDown(0);
+        } else {
+            auto &level = levels[firstLevel];
+            removeFromBucket(Key(firstLevel, level.first), level.buckets[level.first].head);
+        }
+        --count;
+        return node;
+    };
+
+    Node *pop() {
+        if (backend == Backend::MULTIMAP) return pop<Backend::MULTIMAP>();
+        if (backend == Backend::HEAP) return pop<Backend::HEAP>();
+        return pop<Backend::BUCKET>();
+    };
+
+    // erase a node in the list
+    template<Backend B, bool ExtraCost>
+    void erase(Node *node) {
+        if constexpr (B == Backend::MULTIMAP) {
+            auto range = multimap.equal_range(getKey<ExtraCost>(node));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == node) {
+                    multimap.erase(it);
+                    break;
+                }
+            }
+        } else if constexpr (B == Backend::HEAP) {
+            size_t i = node->openIndex;
+            auto last = heap.back();
+            heap.pop_back();
+            if (i < heap.size()) {
+                place(i, last);
+                if (i > 0 && heap[i] < heap[(i - 1) / ARITY]) siftUp(i);
+                else siftDown(i);
+            }
+        } else {
+            removeFromBucket(getKey<ExtraCost>(node), node->openIndex);
+        }
+        --count;
+    };
+
+    void erase(Node *node) {
+        if (backend == Backend::MULTIMAP) erase<Backend::MULTIMAP, true>(node);
+        else if (backend == Backend::HEAP) erase<Backend::HEAP, true>(node);
+        else erase<Backend::BUCKET, true>(node);
+    };
+
+    // call f(node) on all nodes in no particular order
+    template<typename F>
+    void forEach(F f) const {
+        for (const auto &item : multimap) f(item.second);
+        for (const auto &entry : heap) f(entry.node);
+        for (size_t i = touchedBegin; i < touchedEnd; i++) {
+            for (const auto &bucket : levels[i].buckets) {
+                for (size_t j = bucket.head; j < bucket.nodes.size(); j++) {
+                    if (bucket.nodes[j]) f(bucket.nodes[j]);
+                }
+            }
+        }
+    };
+
+    // remove all nodes, the buckets are kept for the next search
+    void clear() {
+        multimap.clear();
+        heap.clear();
+        sequence = 0;
+        for (size_t i = touchedBegin; i < touchedEnd; i++) {
+            auto &level = levels[i];
+            for (auto &bucket : level.buckets) {
+                bucket.nodes.clear();
+                bucket.head = bucket.count = 0;
+            }
+            level.first = level.count = 0;
+        }
+        firstLevel = touchedBegin = touchedEnd = 0;
+        count = 0;
+    };
+};
+
+
+#endif //MAPF_OPENLIST_H
@@ -0,0 +1,89 @@
+#include "ReservationOverlay.h"
+
+#include <iostream>
+#include <limits>
+#include <algorithm>
+
+void ReservationOverlay::touch(Map::CellId id) {
+    if (touched.size() != map->getCellCount()) touched.assign(map->getCellCount(), 0);
+    if (!touched[id]) {
+        touched[id] = 1;
+        touchedCells.emplace_back(id);
+    }
+}
+
+IntervalSet *ReservationOverlay::getSlot(Map::CellId id, Map::Direction direction, bool create) {
+    auto key = getKey(id, direction);
+    auto it = slots.find(key);
+    if (it != slots.end()) return &it->second;
+    auto slot = map->findReservation(id, direction);
+    if (!slot && !create) return nullptr;
+    // an edge slot is also used by the node on the other side of the edge
+    touch(id);
+    if (direction != Map::Direction::NONE) touch(map->getNeighbor(id, direction));
+    return &slots.emplace(key, slot ? slot->rangeConstraints : IntervalSet()).first->second;
+}
+
+void ReservationOverlay::clear() {
+    slots.clear();
+    extraCostTimes.clear();
+    for (auto id : touchedCells) touched[id] = 0;
+    touchedCells.clear();
+}
+
+void ReservationOverlay::addEdgeOccupied(Map::CellId id, Map::Direction direction, size_t startTime,
+                                         size_t endTime) {
+    if (endTime <= startTime) return;
+    getSlot(id, direction, true)->add(Interval(startTime, endTime));
+}
+
+void ReservationOverlay::removeEdgeOccupied(Map::CellId id, Map::Direction direction, size_t startTime,
+                                            size_t endTime) {
+    if (endTime <= startTime) return;
+    auto occupied = getSlot(id, direction, false);
+    if (occupied) {
+        occupied->subtract(Interval(startTime, endTime));
+    } else {
+        std::cerr << "remove error: not found" << std::endl;
+    }
+}
+
+size_t ReservationOverlay::removeInfiniteWaiting(Map::CellId id) {
+    touch(id);
+    auto extraCostTime = std::make_pair(id, std::numeric_limits<size_t>::max());
+    auto it = std::find_if(extraCostTimes.begin(), extraCostTimes.end(),
+                           [id](const std::pair<Map::CellId, size_t> &item) { return item.first == id; });
+    if (it != extraCostTimes.end()) *it = extraCostTime;
+    else extraCostTimes.emplace_back(extraCostTime);
+
+    size_t infinite = std::numeric_limits<size_t>::max() / 2;
+    auto slot = map->findReservation(id, Map::Direction::NONE);
+    auto occupied = find(id, Map::Direction::NONE);
+    if (slot && occupied && !occupied->empty()) {
+        auto last = occupied->rbegin();
+        if (last->upper() >= infinite) {
+            size_t result = std::max(last->lower(), slot->infiniteWaiting);
+            removeEdgeOccupied(id, Map::Direction::NONE, result, last->upper());
+            return result;
+        }
+    }
+    return infinite;
+}
+
+IntervalSet *ReservationOverlay::find(Map::CellId id, Map::Direction direction) {
+    if (isTouched(id)) {
+        auto it = slots.find(getKey(id, direction));
+        if (it != slots.end()) return &it->second;
+    }
+    auto slot = map->findReservation(id, direction);
+    return slot ? &slot->rangeConstraints : nullptr;
+}
+
+size_t ReservationOverlay::getExtraCostTime(Map::CellId id) const {
+    if (isTouched(id)) {
+        for (const auto &item : extraCostTimes) {
+            if (item.first == id) return item.second;
+        }
+    }
+    return map->getExtraCostTime(id);
+}
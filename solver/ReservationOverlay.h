@@ -0,0 +1,74 @@
+#ifndef MAPF_RESERVATIONOVERLAY_H
+#define MAPF_RESERVATIONOVERLAY_H
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+
+#include "Map.h"
+
+// The reservations of a map as seen by the searches of one solver, with some intervals masked (the reservations of
+// the agent being evaluated, see Manager::evaluateAgent) or tentatively added, the map itself is never changed
+//
+// a slot is copied into the overlay on its first change and the other slots are read from the map,
+// so the solvers of several threads can search on the same map, each with its own overlay
+// the intervals in the map have no owner, the reservations of an agent are masked by subtracting the intervals
+// the agent reserved (the manager knows them), in the same way as the Map mutators with the same names
+class ReservationOverlay {
+private:
+    const Map *map;
+    std::unordered_map<uint64_t, IntervalSet> slots;    // the changed slots by getKey
+    std::vector<std::pair<Map::CellId, size_t> > extraCostTimes;   // the changed extra cost times
+    std::vector<uint8_t> touched;           // cell id -> the reservations of the cell or an edge of it are changed
+    std::vector<Map::CellId> touchedCells;
+
+    uint64_t getKey(Map::CellId id, Map::Direction direction) const {
+        auto key = map->getReservationKey(id, direction);
+        return (uint64_t) key.first * ReservationTable::SLOT_TYPES + (uint64_t) key.second;
+    };
+
+    void touch(Map::CellId id);
+
+    // the copy of the slot in the overlay, created from the map if the slot is not changed yet,
+    // nullptr if there is no slot and create is false
+    IntervalSet *getSlot(Map::CellId id, Map::Direction direction, bool create);
+
+public:
+    explicit ReservationOverlay(const Map *map) : map(map) {}
+
+    ReservationOverlay(const ReservationOverlay &) = delete;
+
+    ReservationOverlay &operator=(const ReservationOverlay &) = delete;
+
+    bool empty() const { return touchedCells.empty(); };
+
+    // drop all changes, the results of find are invalid after it
+    void clear();
+
+    void addEdgeOccupied(Map::CellId id, Map::Direction direction, size_t startTime, size_t endTime);
+
+    void removeEdgeOccupied(Map::CellId id, Map::Direction direction, size_t startTime, size_t endTime);
+
+    void addNodeOccupied(Map::CellId id, size_t startTime, size_t endTime) {
+        addEdgeOccupied(id, Map::Direction::NONE, startTime, endTime);
+    };
+
+    void removeNodeOccupied(Map::CellId id, size_t startTime, size_t endTime) {
+        removeEdgeOccupied(id, Map::Direction::NONE, startTime, endTime);
+    };
+
+    // returns the start of the removed infinite waiting (infinite if there is none), see Map::removeInfiniteWaiting
+    size_t removeInfiniteWaiting(Map::CellId id);
+
+    // the reservations of the cell or an edge of it differ from the map
+    bool isTouched(Map::CellId id) const { return id < touched.size() && touched[id]; };
+
+    // the occupied intervals of a vertex (NONE) or an edge, nullptr if there is no slot
+    IntervalSet *find(Map::CellId id, Map::Direction direction);
+
+    size_t getExtraCostTime(Map::CellId id) const;
+};
+
+
+#endif //MAPF_RESERVATIONOVERLAY_H
@@ -0,0 +1,72 @@
+#include "ReservationTable.h"
+
+constexpr size_t ReservationTable::SLOT_TYPES;
+constexpr uint64_t ReservationTable::EMPTY_KEY;
+
+ReservationTable::ReservationTable(size_t cellCount, Backend backend) : backend(backend), cellCount(cellCount) {
+    if (backend == Backend::DENSE) {
+        slots.resize(cellCount * SLOT_TYPES);
+    } else {
+        rehash(6);
+    }
+}
+
+ReservationTable::Slot *ReservationTable::findSparse(uint64_t key) const {
+    size_t mask = buckets.size() - 1;
+    for (size_t i = getBucket(key);; i = (i + 1) & mask) {
+        if (buckets[i].key == key) {
+            return const_cast<Slot *>(&sparseSlots[buckets[i].index].second);
+        }
+        if (buckets[i].key == EMPTY_KEY) return nullptr;
+    }
+}
+
+void ReservationTable::rehash(size_t bits) {
+    bucketBits = bits;
+    buckets.assign(size_t(1) << bits, Bucket{EMPTY_KEY, 0});
+    size_t mask = buckets.size() - 1;
+    for (size_t index = 0; index < sparseSlots.size(); index++) {
+        size_t i = getBucket(sparseSlots[index].first);
+        while (buckets[i].key != EMPTY_KEY) i = (i + 1) & mask;
+        buckets[i] = Bucket{sparseSlots[index].first, (uint32_t) index};
+    }
+}
+
+ReservationTable::Slot &ReservationTable::get(size_t cell, SlotType type) {
+    auto key = getKey(cell, type);
+    if (backend == Backend::DENSE) return slots[key];
+
+    size_t mask = buckets.size() - 1;
+    size_t i = getBucket(key);
+    for (; buckets[i].key != EMPTY_KEY; i = (i + 1) & mask) {
+        if (buckets[i].key == key) return sparseSlots[buckets[i].index].second;
+    }
+    ++version;
+    // keep the load factor below 1/2 so that the probe sequences stay short
+    if ((sparseSlots.size() + 1) * 2 > buckets.size()) {
+        sparseSlots.emplace_back(key, Slot());
+        rehash(bucketBits + 1);
+    } else {
+        buckets[i] = Bucket{key, (uint32_t) sparseSlots.size()};
+        sparseSlots.emplace_back(key, Slot());
+    }
+    return sparseSlots.back().second;
+}
+
+ReservationTable::CollectStats ReservationTable::collect(size_t watermark) {
+    CollectStats stats;
+    auto collectSlot = [&stats, watermark](Slot &slot) {
+        auto &occupied = slot.rangeConstraints;
+        if (occupied.empty() || occupied.begin()->upper() > watermark) return;
+        auto memory = getMemoryUsage(occupied);
+        stats.intervals += eraseBefore(occupied, watermark);
+        shrinkToFit(occupied);
+        stats.bytes += memory - getMemoryUsage(occupied);
+    };
+    if (backend == Backend::DENSE) {
+        for (auto &slot : slots) collectSlot(slot);
+    } else {
+        for (auto &item : sparseSlots) collectSlot(item.second);
+    }
+    return stats;
+}
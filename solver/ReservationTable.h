@@ -0,0 +1,115 @@
+#ifndef MAPF_RESERVATIONTABLE_H
+#define MAPF_RESERVATIONTABLE_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstdint>
+#include <limits>
+
+#include "IntervalSet.h"
+
+// Reservations (occupied intervals and waiting agents) of the vertices and edges of the map
+// an undirected edge is stored once on the cell at its upper or left end, so a cell has three slots:
+// the vertex, the edge to the right neighbor and the edge to the lower neighbor
+//
+// the dense backend keeps the slots of all cells inline in a flat array indexed by cell id,
+// the sparse backend only allocates the slots in use (open addressing index over a deque) for huge maps
+// with few reservations, pointers to the slots are stable in both backends
+class ReservationTable {
+public:
+    enum class Backend {
+        DENSE, SPARSE
+    };
+
+    enum class SlotType {
+        VERTEX, RIGHT, DOWN
+    };
+
+    static constexpr size_t SLOT_TYPES = 3;
+
+    struct Slot {
+        IntervalSet rangeConstraints;
+        size_t infiniteWaiting = 0;
+        std::map<size_t, size_t> waitingAgents;
+
+        bool empty() const { return rangeConstraints.empty() && waitingAgents.empty(); };
+    };
+
+    struct CollectStats {
+        size_t intervals = 0;   // erased intervals
+        size_t bytes = 0;       // heap memory released by the interval sets
+    };
+
+private:
+    struct Bucket {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    static constexpr uint64_t EMPTY_KEY = std::numeric_limits<uint64_t>::max();
+
+    Backend backend;
+    size_t cellCount;
+
+    std::vector<Slot> slots;                            // dense, cellCount x SLOT_TYPES
+    std::deque<std::pair<uint64_t, Slot> > sparseSlots; // sparse, the key and the slot in insertion order
+    std::vector<Bucket> buckets;                        // sparse, the size is a power of 2
+
+    static uint64_t getKey(size_t cell, SlotType type) { return cell * SLOT_TYPES + (size_t) type; };
+
+    size_t getBucket(uint64_t key) const {
+        // fibonacci hashing, the high bits are mixed best
+        return (key * 11400714819323198485ull) >> (64 - bucketBits);
+    };
+
+    size_t bucketBits = 0;
+    size_t version = 0;     // increased when a slot is created
+
+    Slot *findSparse(uint64_t key) const;
+
+    void rehash(size_t bits);
+
+public:
+    ReservationTable(size_t cellCount, Backend backend);
+
+    auto getBackend() const { return this->backend; };
+
+    // changed whenever a slot is created (never in the dense backend), so that the users can
+    // keep the result of find until then
+    auto getVersion() const { return this->version; };
+
+    // the slot if it exists (always in the dense backend), nullptr otherwise
+    Slot *find(size_t cell, SlotType type) {
+        if (backend == Backend::DENSE) return &slots[getKey(cell, type)];
+        return findSparse(getKey(cell, type));
+    };
+
+    const Slot *find(size_t cell, SlotType type) const {
+        if (backend == Backend::DENSE) return &slots[getKey(cell, type)];
+        return findSparse(getKey(cell, type));
+    };
+
+    // the slot, created if it does not exist
+    Slot &get(size_t cell, SlotType type);
+
+    // erase the occupied intervals that end before the watermark (no agent can act before it)
+    CollectStats collect(size_t watermark);
+
+    // call f(cell, type, slot) on the slots that are not empty
+    template<typename F>
+    void forEach(F f) const {
+        if (backend == Backend::DENSE) {
+            for (size_t i = 0; i < slots.size(); i++) {
+                if (!slots[i].empty()) f(i / SLOT_TYPES, SlotType(i % SLOT_TYPES), slots[i]);
+            }
+        } else {
+            for (const auto &item : sparseSlots) {
+                if (!item.second.empty()) f(item.first / SLOT_TYPES, SlotType(item.first % SLOT_TYPES), item.second);
+            }
+        }
+    };
+};
+
+
+#endif //MAPF_RESERVATIONTABLE_H
@@ -5,44 +5,40 @@
 #include "Solver.h"
 
 #include <iostream>
+#include <chrono>
 #include <limits>
+#include <cassert>
 #include <algorithm>
 
-bool Solver::isOccupied(boost::icl::interval_set<size_t> *occupied, boost::icl::discrete_interval<size_t> interval) {
+bool Solver::isOccupied(IntervalSet *occupied, Interval interval) {
     if (!occupied) return false;
-    return boost::icl::intersects(*occupied, interval);
+    return intersects(*occupied, interval);
 }
 
 
-bool Solver::isOccupied(boost::icl::interval_set<size_t> *occupied, size_t startTime, size_t endTime) {
-    return isOccupied(occupied, boost::icl::discrete_interval<size_t>(startTime, endTime));
+bool Solver::isOccupied(IntervalSet *occupied, size_t startTime, size_t endTime) {
+    return isOccupied(occupied, Interval(startTime, endTime));
 }
 
-bool Solver::isOccupied(boost::icl::interval_set<size_t> *occupied, size_t timeStart) {
+bool Solver::isOccupied(IntervalSet *occupied, size_t timeStart) {
     return isOccupied(occupied, timeStart, timeStart + 1);
 }
 
-bool Solver::isOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime) {
-    boost::icl::interval_set<size_t> *occupied;
-    if (direction == Map::Direction::NONE) {
-        occupied = nodes[pos.first][pos.second].occupied;
-    } else {
-        occupied = nodes[pos.first][pos.second].edges[(size_t) direction].occupied;
-    }
-    return isOccupied(occupied, startTime, endTime);
+bool Solver::isOccupied(Map::CellId pos, Map::Direction direction, size_t startTime, size_t endTime) {
+    return isOccupied(overlay.find(pos, direction), startTime, endTime);
 }
 
 std::pair<size_t, size_t>
-Solver::findNotOccupiedInterval(boost::icl::interval_set<size_t> *occupied, size_t startTime, size_t endTime) {
+Solver::findNotOccupiedInterval(IntervalSet *occupied, size_t startTime, size_t endTime) {
     if (!occupied || occupied->empty()) return {0, std::numeric_limits<size_t>::max()};
-    auto interval = boost::icl::discrete_interval<size_t>(startTime, endTime);
+    auto interval = Interval(startTime, endTime);
 
     // find the interval [a,b) > [startTime, endTime)
     auto it = occupied->upper_bound(interval);
     if (it != occupied->begin()) --it;
 
     for (; it != occupied->end(); ++it) {
-        if (boost::icl::intersects(interval, *it)) {
+        if (intersects(interval, *it)) {
             return {0, 0};
         }
         if (endTime <= it->lower()) {
@@ -62,16 +58,16 @@ Solver::findNotOccupiedInterval(boost::icl::interval_set<size_t> *occupied, size
 }
 
 std::pair<size_t, size_t>
-Solver::findNotOccupiedInterval(boost::icl::interval_set<size_t> *occupied, size_t startTime) {
+Solver::findNotOccupiedInterval(IntervalSet *occupied, size_t startTime) {
     return findNotOccupiedInterval(occupied, startTime, startTime + 1);
 }
 
 
 // find the smallest newTime >= startTime so that [newTime, newTime + duration) is not occupied
 size_t
-Solver::findFirstNotOccupiedTimestamp(boost::icl::interval_set<size_t> *occupied, size_t startTime, size_t duration) {
+Solver::findFirstNotOccupiedTimestamp(IntervalSet *occupied, size_t startTime, size_t duration) {
     if (!occupied || occupied->empty()) return startTime;
-    auto interval = boost::icl::discrete_interval<size_t>(startTime, startTime + duration);
+    auto interval = Interval(startTime, startTime + duration);
 
     auto it = occupied->upper_bound(interval);
     if (it != occupied->begin()) --it;
@@ -87,13 +83,13 @@ Solver::findFirstNotOccupiedTimestamp(boost::icl::interval_set<size_t> *occupied
 
 // find the smallest newTime >= startTime so that [newTime, newTime + duration) is not occupied,
 // and newTime + duration is not occupied2
-size_t Solver::findFirstNotOccupiedTimestamp(boost::icl::interval_set<size_t> *occupied,
-                                             boost::icl::interval_set<size_t> *occupied2,
+size_t Solver::findFirstNotOccupiedTimestamp(IntervalSet *occupied,
+                                             IntervalSet *occupied2,
                                              size_t startTime, size_t duration) {
     if (!occupied || occupied->empty()) {
         return findFirstNotOccupiedTimestamp(occupied2, startTime + duration, 1) - duration;
     }
-    auto interval = boost::icl::discrete_interval<size_t>(startTime, startTime + duration);
+    auto interval = Interval(startTime, startTime + duration);
 
     auto it = occupied->upper_bound(interval);
     if (it != occupied->begin()) --it;
@@ -116,76 +112,150 @@ size_t Solver::findFirstNotOccupiedTimestamp(boost::icl::interval_set<size_t> *o
     return distance;
 }*/
 
+void Solver::initHeuristic() {
+    remainders.assign(scenario->size(), 0);
+    checkpointRows.assign(scenario->size(), Map::DistanceRow());
+    checkpointLandmarks.assign(scenario->size(), nullptr);
+    checkpointEnds.resize(scenario->size());
+    for (size_t i = 0; i < scenario->size(); i++) {
+        checkpointEnds[i] = map->getCellId(scenario->getEnd(i));
+    }
+    if (heuristic == Heuristic::GRAPH) {
+        // the rows are read from the map (its table or its cache, bounded by --distance-cache), not copied
+        for (size_t i = 0; i < scenario->size(); i++) {
+            // the ends are checked to be traversable in initScenario
+            checkpointRows[i] = map->getGraphDistanceRow(checkpointEnds[i]);
+        }
+        for (size_t i = scenario->size() - 1; i > 0; i--) {
+            remainders[i - 1] = std::min(DistanceTable::INFINITE_DISTANCE, remainders[i] +
+                    map->getGraphDistance(checkpointEnds[i - 1], checkpointEnds[i]));
+        }
+    } else if (heuristic == Heuristic::LANDMARK) {
+        auto landmarks = map->getLandmarks();
+        assert(landmarks);
+        for (size_t i = 0; i < scenario->size(); i++) {
+            // the ends are checked to be traversable in initScenario
+            checkpointLandmarks[i] = landmarks->getDistances(map->getDistanceIndex(checkpointEnds[i]));
+        }
+        for (size_t i = scenario->size() - 1; i > 0; i--) {
+            remainders[i - 1] = std::min(DistanceTable::INFINITE_DISTANCE, remainders[i] +
+                    landmarks->getLowerBound(checkpointLandmarks[i - 1], checkpointLandmarks[i]));
+        }
+    } else {
+        for (size_t i = 0; i < scenario->size(); i++) {
+            remainders[i] = scenario->getDistance(i);
+        }
+    }
+}
+
+template<Solver::Heuristic H>
+size_t Solver::getHeuristic(Map::CellId pos, size_t checkpoint) const {
+    if (checkpoint >= scenario->size()) checkpoint = scenario->size() - 1;
+    if constexpr (H == Heuristic::GRAPH) {
+        // an unreachable goal gives an estimate beyond any deadline
+        return std::min(DistanceTable::INFINITE_DISTANCE,
+                        checkpointRows[checkpoint].get(map->getDistanceIndex(pos)) +
+                        remainders[checkpoint]);
+    } else if constexpr (H == Heuristic::LANDMARK) {
+        auto landmarks = map->getLandmarks();
+        auto distances = landmarks->getDistances(map->getDistanceIndex(pos));
+        return std::min(DistanceTable::INFINITE_DISTANCE,
+                        landmarks->getLowerBound(distances, checkpointLandmarks[checkpoint]) +
+                        remainders[checkpoint]);
+    } else {
+        return Map::getDistance(map->getPos(pos), scenario->getEnd(checkpoint)) + remainders[checkpoint];
+    }
+}
+
+template<bool ExtraCost, Solver::Heuristic H>
 Solver::VirtualNode *
-Solver::createVirtualNode(std::pair<size_t, size_t> pos, size_t leaveTime, Solver::VirtualNode *parent,
+Solver::createVirtualNode(Map::CellId pos, size_t leaveTime, Solver::VirtualNode *parent,
                           size_t checkpoint, bool isOpen) {
-    return createVirtualNode(pos, leaveTime, parent, checkpoint, std::make_pair(0, 0), isOpen, false);
+    return createVirtualNode<ExtraCost, H>(pos, leaveTime, parent, checkpoint, 0, isOpen, false);
 //    size_t estimateTime = leaveTime + Map::getDistance(pos, scenario->getEnd());
 //    return new VirtualNode{pos, leaveTime, estimateTime, parent, std::make_pair(0, 0), checkpoint, false, isOpen};
 }
 
+template<bool ExtraCost, Solver::Heuristic H>
 Solver::VirtualNode *
-Solver::createVirtualNode(std::pair<size_t, size_t> pos, size_t leaveTime, Solver::VirtualNode *parent,
-                          size_t checkpoint, std::pair<size_t, size_t> child, bool isOpen, bool hasChild) {
+Solver::createVirtualNode(Map::CellId pos, size_t leaveTime, Solver::VirtualNode *parent,
+                          size_t checkpoint, Map::CellId child, bool isOpen, bool hasChild) {
 //    size_t checkpoint = parent ? parent->checkpoint : 0;
-    size_t estimateTime = leaveTime;
-    if (checkpoint < scenario->size()) {
-        estimateTime += Map::getDistance(pos, scenario->getEnd(checkpoint));
-        estimateTime += scenario->getDistance(checkpoint);
-    } else {
-        estimateTime += Map::getDistance(pos, scenario->getEnd());
-    }
+    size_t estimateTime = leaveTime + getHeuristic<H>(pos, checkpoint);
     size_t extraCost = 0;
-    if (extraCostId > 0) {
-        size_t extraCostTime = map->getExtraCostTime(pos);
+    if (ExtraCost) {
+        size_t extraCostTime = overlay.getExtraCostTime(pos);
         if (extraCostTime <= leaveTime) extraCost++;
         if (parent) extraCost += parent->extraCost;
     }
 //    std::cout << pos.first << " " << pos.second << " " << checkpoint << " " << leaveTime << " " << estimateTime << std::endl;
 //    size_t estimateTime = leaveTime + Map::getDistance(pos, scenario->getEnd());
-    return new VirtualNode{pos, leaveTime, estimateTime, parent, child, checkpoint, extraCost, hasChild, isOpen};
+    // an estimate beyond the deadline is only compared with it (see replaceNode and addVirtualNodeToOpen)
+    estimateTime = std::min(estimateTime, deadline + 1);
+    auto childDirection = hasChild ? map->getDirectionByCell(pos, child) : Map::Direction::NONE;
+    return virtualNodeArena.create(pos, (uint32_t) leaveTime, (uint32_t) estimateTime, (uint32_t) extraCost, parent,
+                                   (uint16_t) checkpoint, (uint8_t) childDirection, hasChild, isOpen);
 }
 
-
-Solver::VirtualNode *
-Solver::removeVirtualNodeFromList(VirtualNodeQueue &list, VirtualNodeQueue::iterator it, bool editNode) {
-    auto vNode = it->second;
-    list.erase(it);
-    if (editNode) {
-        auto &node = nodes[vNode->pos.first][vNode->pos.second];
-        node.virtualNodes.erase(vNode);
-    }
-//    if (&list == &open) {
-//        std::cerr << "remove " << vNode->pos.first << " " << vNode->pos.second << " " << vNode->estimateTime << " "
-//                  << vNode->extraCost << std::endl;
-//    }
-    return vNode;
-}
-
-void Solver::addVirtualNodeToList(VirtualNodeQueue &list, VirtualNode *vNode, bool editNode) {
+template<Solver::VirtualNodeOpenList::Backend B, bool ExtraCost>
+void Solver::addVirtualNodeToOpen(VirtualNode *vNode) {
 //    if (vNode->isOpen && extraCostFlag && maybeSuccessNode && vNode->leaveTime > maybeSuccessNode->leaveTime) {
 //        delete vNode;
 //        return;
 //    }
     if (vNode->estimateTime >= deadline) {
-        delete vNode;
+        virtualNodeArena.destroy(vNode);
         return;
     }
 //    if (&list == &open) {
 //        std::cerr << "push " << vNode->pos.first << " " << vNode->pos.second << " " << vNode->estimateTime << " "
 //                  << vNode->extraCost << std::endl;
 //    }
-/*    auto &node = nodes[vNode->pos.first][vNode->pos.second];
+/*    auto &node = getNode(vNode->pos);
     if (isOccupied(node.occupied, vNode->leaveTime)) {
         std::cerr << "error: " << vNode->pos.first << " " << vNode->pos.second << " " << vNode->leaveTime << std::endl;
         Map::printOccupied(node.occupied);
         std::cerr << std::endl;
     }*/
 
-    list.emplace(std::pair<size_t, size_t>(vNode->estimateTime, vNode->extraCost), vNode);
-    if (editNode) {
-        auto &node = nodes[vNode->pos.first][vNode->pos.second];
-        node.virtualNodes.emplace(vNode);
+    open.push<B, ExtraCost>(vNode);
+    if (!vNode->hasChild) addToState(getNode(vNode->pos), vNode);
+}
+
+size_t Solver::getSafeIntervalStart(const Node &node, size_t time) {
+    auto interval = findNotOccupiedInterval(node.occupied, time);
+    return interval.first != interval.second ? interval.first : NO_SAFE_INTERVAL;
+}
+
+void Solver::addToState(Node &node, VirtualNode *vNode) {
+    auto intervalStart = getSafeIntervalStart(node, vNode->leaveTime);
+    // a cell only has a few states in a search
+    for (auto &state : node.getStates()) {
+        if (state.intervalStart == intervalStart && state.checkpoint == vNode->checkpoint) {
+            state.earliestLeaveTime = std::min<size_t>(state.earliestLeaveTime, vNode->leaveTime);
+            state.vNodes.emplace_back(vNode);
+            return;
+        }
+    }
+    if (node.stateCount == node.states.size()) node.states.emplace_back();
+    auto &state = node.states[node.stateCount++];
+    state.intervalStart = intervalStart;
+    state.checkpoint = vNode->checkpoint;
+    state.earliestLeaveTime = vNode->leaveTime;
+    state.vNodes.clear();
+    state.vNodes.emplace_back(vNode);
+}
+
+void Solver::removeFromState(Node &node, VirtualNode *vNode) {
+    auto intervalStart = getSafeIntervalStart(node, vNode->leaveTime);
+    for (auto &state : node.getStates()) {
+        if (state.intervalStart != intervalStart || state.checkpoint != vNode->checkpoint) continue;
+        state.vNodes.erase(std::find(state.vNodes.begin(), state.vNodes.end(), vNode));
+        state.earliestLeaveTime = NO_SAFE_INTERVAL;
+        for (auto other : state.vNodes) {
+            state.earliestLeaveTime = std::min<size_t>(state.earliestLeaveTime, other->leaveTime);
+        }
+        return;
     }
 }
 
@@ -201,53 +271,72 @@ std::vector<Solver::VirtualNode *> Solver::constructPath(VirtualNode *vNode) {
 
 void Solver::initialize() {
     clean();
-    nodes.resize(map->getHeight());
-    for (size_t i = 0; i < map->getHeight(); i++) {
-        nodes[i].resize(map->getWidth());
-        for (size_t j = 0; j < map->getWidth(); j++) {
-            for (auto direction : Map::directions) {
-                auto p = map->getPosByDirection({i, j}, direction);
-                if (!p.first || (*map)[p.second.first][p.second.second] == '@') {
-                    nodes[i][j].edges[(size_t) direction].available = false;
-                }
-            }
-        }
+    // the grid is only allocated again when the traversable cells change,
+    // otherwise the nodes are reset lazily when the search touches them
+    if (nodes.size() != map->getCellCount() || nodesTopologyVersion != map->getTopologyVersion()) {
+        nodes.assign(map->getCellCount(), Node());
+        nodesTopologyVersion = map->getTopologyVersion();
+        generation = 1;
     }
-    for (const auto &item: map->getOccupiedMap()) {
-        if (item.first.direction == Map::Direction::NONE) {
-            nodes[item.first.pos.first][item.first.pos.second].occupied = &item.second->rangeConstraints;
-        } else {
-            auto &node1 = nodes[item.first.pos.first][item.first.pos.second];
-            auto dir1 = (size_t) item.first.direction;
-            node1.edges[dir1].occupied = &item.second->rangeConstraints;
-            auto p = map->getPosByDirection(item.first.pos, item.first.direction);
-            if (p.first) {
-                auto &node2 = nodes[p.second.first][p.second.second];
-                auto dir2 = (dir1 + 2) % 4;
-                node2.edges[dir2].occupied = &item.second->rangeConstraints;
-            }
-        }
+}
+
+void Solver::resetNode(Map::CellId id, Node &node) {
+    node.generation = generation;
+    node.stateCount = 0;
+    auto &reservations = map->getReservations();
+    // the nodes synced with the overlay of another search are synced again
+    bool overlaid = overlay.isTouched(id);
+    if (node.reservationVersion == reservations.getVersion() && !overlaid && !node.overlaid) return;
+    node.reservationVersion = reservations.getVersion();
+    node.overlaid = overlaid;
+    node.occupied = overlay.find(id, Map::Direction::NONE);
+    // only the edges to the traversable neighbors are used (see Map::getNeighbors)
+    for (const auto &neighbor : map->getNeighbors(id)) {
+        node.edges[(size_t) neighbor.direction].occupied = overlay.find(id, neighbor.direction);
     }
 }
 
 void Solver::clean() {
-    nodes.clear();
-    for (auto item : open) {
-        delete item.second;
-    }
-    for (auto item : closed) {
-        delete item.second;
-    }
+    // all virtual nodes are released at once
+    virtualNodeArena.reset();
     open.clear();
     closed.clear();
     successNode = nullptr;
     maybeSuccessNode = nullptr;
+    // the virtual nodes in the node grid are deleted, mark all nodes stale
+    if (++generation == 0) {
+        for (auto &node : nodes) node.generation = 0;
+        generation = 1;
+    }
+}
+void Solver::printAllocationStats() const {
+    auto &stats = virtualNodeArena.getStats();
+    std::cerr << "Solver virtual nodes: " << stats.objects << " created (" << stats.reused << " reused) in "
+              << stats.resets << " searches, node arena: " << stats.slabs << " slabs ("
+              << stats.slabs * Arena<VirtualNode>::SLAB_SIZE * sizeof(VirtualNode) / 1024
+              << " KiB), other allocations of the searches are not counted" << std::endl;
 }
 
+std::vector<Solver::VirtualNode *> Solver::getSortedOpen() const {
+    std::vector<VirtualNode *> result;
+    open.forEach([&result](VirtualNode *vNode) { result.emplace_back(vNode); });
+    std::stable_sort(result.begin(), result.end(), [this](const VirtualNode *a, const VirtualNode *b) {
+        return open.getKey(a) < open.getKey(b);
+    });
+    return result;
+}
+
+std::vector<Solver::VirtualNode *> Solver::getSortedClosed() const {
+    auto result = closed;
+    std::stable_sort(result.begin(), result.end(), [this](const VirtualNode *a, const VirtualNode *b) {
+        return open.getKey(a) < open.getKey(b);
+    });
+    return result;
+}
 
-Solver::Solver(Map *map, int algorithmId, int extraCostId) :
-        map(map), algorithmId(algorithmId), extraCostId(extraCostId),
-        open(VirtualNodePairComp{extraCostId}), closed(VirtualNodePairComp{extraCostId}) {
+Solver::Solver(Map *map, int extraCostId) :
+        map(map), overlay(map), extraCostId(extraCostId),
+        open(VirtualNodeOpenList::Backend::MULTIMAP, extraCostId) {
 }
 
 Solver::~Solver() {
@@ -256,7 +345,10 @@ Solver::~Solver() {
 
 void Solver::initScenario(const Scenario *_scenario, size_t startTime, size_t _deadline) {
     this->scenario = _scenario;
-    this->deadline = _deadline;
+    this->deadline = std::min(_deadline, MAX_TIME);
+    if (startTime >= MAX_TIME || scenario->size() > std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error("scenario out of the range of the solver");
+    }
 
     // skip the algorithm if start or end point is blocked
     auto start = scenario->getStart();
@@ -268,14 +360,77 @@ void Solver::initScenario(const Scenario *_scenario, size_t startTime, size_t _d
 
     // Initialize the OPEN and CLOSED lists to be empty
     initialize();
+    initHeuristic();
 
     // Construct a virtual node (v', h_v', null), added into the OPEN list
-    auto startVNode = createVirtualNode(scenario->getStart(), startTime, nullptr, 0, true);
-    addVirtualNodeToList(open, startVNode, true);
+    auto startPos = map->getCellId(scenario->getStart());
+    withSearchOptions([&](auto backend, auto heuristicOption) {
+        constexpr auto B = decltype(backend)::value;
+        constexpr auto H = decltype(heuristicOption)::value;
+        if (extraCostId > 0) {
+            addVirtualNodeToOpen<B, true>(createVirtualNode<true, H>(startPos, startTime, nullptr, 0, true));
+        } else {
+            addVirtualNodeToOpen<B, false>(createVirtualNode<false, H>(startPos, startTime, nullptr, 0, true));
+        }
+    });
+}
+
+Solver::SearchResult Solver::getSearchResult(size_t steps, bool budgetUsedUp) {
+    if (success()) {
+        return SearchResult{SearchResult::Status::SUCCESS, steps, successNode->leaveTime, successNode};
+    }
+    if (open.empty()) {
+        return SearchResult{SearchResult::Status::NO_PATH, steps, deadline, nullptr};
+    }
+    // the heuristic is admissible, no path arrives before the smallest estimate in the OPEN list
+    auto status = budgetUsedUp ? SearchResult::Status::BUDGET : SearchResult::Status::STEP_LIMIT;
+    return SearchResult{status, steps, open.getLowerBound(), open.top()};
 }
 
-void Solver::replaceNode(VirtualNode *vNode, std::pair<size_t, size_t> pos,
-                         Node &neighborNode, Edge &edge, bool needExamine) {
+bool Solver::closeNode(VirtualNode *vNode, Node &node) {
+    // Add (v, h_v, v_p) to the CLOSED list;
+    vNode->isOpen = false;
+    closed.emplace_back(vNode);
+
+    while (vNode->pos == checkpointEnds[vNode->checkpoint]) {
+        // if v is the goal location v''
+        if (vNode->checkpoint == scenario->size() - 1) {
+            if (!vNode->hasChild) {
+                // we have found the solution and exit the algorithm
+                successNode = vNode;
+                /*if (extraCostFlag) {
+                    if (!maybeSuccessNode) {
+                        maybeSuccessNode = vNode;
+                    } else {
+                        assert(vNode->leaveTime <= maybeSuccessNode->leaveTime);
+                        std::cerr << vNode->extraCost << " " << maybeSuccessNode->extraCost << std::endl;
+                        if (vNode->extraCost < maybeSuccessNode->extraCost) {
+                            maybeSuccessNode = vNode;
+                        }
+                    }
+                    if (open.empty()) {
+                        successNode = maybeSuccessNode;
+                    }
+                } else {
+                    successNode = vNode;
+                }*/
+                return false;
+            }
+            break;
+        } else {
+            // the node moves to the state of the next checkpoint
+            if (!vNode->hasChild) removeFromState(node, vNode);
+            vNode->checkpoint++;
+            if (!vNode->hasChild) addToState(node, vNode);
+        }
+    }
+    return true;
+}
+
+template<typename ExpansionPolicy, typename OrderingPolicy>
+template<Solver::VirtualNodeOpenList::Backend B, Solver::Heuristic H>
+void SolverT<ExpansionPolicy, OrderingPolicy>::replaceNode(VirtualNode *vNode, Map::CellId pos,
+                                                           Node &neighborNode, Edge &edge, bool needExamine) {
     auto arrivalTime = vNode->leaveTime + 1; // h_v + L_e (L_e = 1 now)
 
     // if h_v + L_e not in O_{\bar{v}} and (h_v, h_v + L_e) /\ O_e = 0
@@ -284,67 +439,57 @@ void Solver::replaceNode(VirtualNode *vNode, std::pair<size_t, size_t> pos,
                          !isOccupied(edge.occupied, vNode->leaveTime, arrivalTime))) {
 
 
-        // create the new node first to help search in the virtualNodes of a node
-        // use arrivalTime + 1 to prevent corner condition mistakes
-        auto newNode = createVirtualNode(pos, arrivalTime + 1, vNode, vNode->checkpoint, true);
-
         // if there exists any virtual node in the OPEN or CLOSED list such that
         // it is in the same or future checkpoint and
-        // h' and h_v+L_e are in the same interval and h' <= h_v+L_e, flag will be false
-        auto flag = true;
-        for (auto it2 = neighborNode.virtualNodes.begin();
-             it2 != neighborNode.virtualNodes.lower_bound(newNode); ++it2) {
-            if ((*it2)->leaveTime <= arrivalTime && (*it2)->leaveTime >= arrivalInterval.first
-                && !(*it2)->hasChild && (*it2)->checkpoint >= vNode->checkpoint) {
-                flag = false;
-                break;
+        // h' and h_v+L_e are in the same interval and h' <= h_v+L_e, it is dominated
+        // an arrival in an occupied time (only in algorithm 1) is checked against the nodes in all intervals
+        auto intervalStart = arrivalInterval.first != arrivalInterval.second ? arrivalInterval.first
+                                                                              : NO_SAFE_INTERVAL;
+        for (const auto &state : neighborNode.getStates()) {
+            if ((state.intervalStart == intervalStart || intervalStart == NO_SAFE_INTERVAL) &&
+                state.checkpoint >= vNode->checkpoint && state.earliestLeaveTime <= arrivalTime) {
+                return;
             }
         }
 
-        if (flag) {
-            // set the leaveTime back to arrivalTime (-1)
-            size_t heuristicTime = newNode->estimateTime - newNode->leaveTime;
-            newNode->leaveTime = arrivalTime;
-
-            // delete all virtual node in the OPEN list such that
-            // h' and h_v+L_e are in the same interval and h' > h_v+L_e
-            size_t deleteCount = 0;
-            for (auto it2 = neighborNode.virtualNodes.upper_bound(newNode);
-                 it2 != neighborNode.virtualNodes.end();) {
-                if ((*it2)->isOpen && (*it2)->leaveTime > arrivalTime &&
-                    (*it2)->leaveTime < arrivalInterval.second && !(*it2)->hasChild &&
-                    (*it2)->checkpoint <= vNode->checkpoint) {
-//                    auto range = open.equal_range((*it2)->estimateTime);
-                    auto rangeBegin = open.lower_bound(std::pair<size_t, size_t>((*it2)->estimateTime, 0));
-                    auto rangeEnd = open.lower_bound(std::pair<size_t, size_t>(
-                            (*it2)->estimateTime, std::numeric_limits<size_t>::max() / 2));
-                    for (auto it3 = rangeBegin; it3 != rangeEnd; ++it3) {
-                        if (it3->second == *it2) {
-                            open.erase(it3);
-                            break;
-                        }
-                    }
-                    auto deleteVNode = *it2;
-                    it2 = neighborNode.virtualNodes.erase(it2);
-                    delete deleteVNode;
-                    ++deleteCount;
-                } else {
-                    ++it2;
+        // use arrivalTime + 1 to prevent corner condition mistakes
+        auto newNode = createVirtualNode<OrderingPolicy::EXTRA_COST, H>(pos, arrivalTime + 1, vNode, vNode->checkpoint, true);
+        // set the leaveTime back to arrivalTime (-1)
+        size_t heuristicTime = newNode->estimateTime - newNode->leaveTime;
+        newNode->leaveTime = arrivalTime;
+
+        // delete all virtual node in the OPEN list such that
+        // h' and h_v+L_e are in the same interval and h' > h_v+L_e
+        if (intervalStart != NO_SAFE_INTERVAL) {
+            for (auto &state : neighborNode.getStates()) {
+                if (state.intervalStart != intervalStart || state.checkpoint > vNode->checkpoint ||
+                    state.earliestLeaveTime == NO_SAFE_INTERVAL) {
+                    continue;
+                }
+                auto it = std::remove_if(state.vNodes.begin(), state.vNodes.end(), [&](VirtualNode *other) {
+                    if (!other->isOpen || other->leaveTime <= arrivalTime) return false;
+                    open.erase<B, OrderingPolicy::EXTRA_COST>(other);
+                    virtualNodeArena.destroy(other);
+                    return true;
+                });
+                if (it == state.vNodes.end()) continue;
+                state.vNodes.erase(it, state.vNodes.end());
+                state.earliestLeaveTime = NO_SAFE_INTERVAL;
+                for (auto other : state.vNodes) {
+                    state.earliestLeaveTime = std::min<size_t>(state.earliestLeaveTime, other->leaveTime);
                 }
             }
-//            if (deleteCount > 1) {
-//                std::cerr << "delete " << deleteCount << std::endl;
-//            }
-            newNode->estimateTime = newNode->leaveTime + heuristicTime;
-            addVirtualNodeToList(open, newNode, true);
-        } else {
-            delete newNode;
         }
+
+        newNode->estimateTime = newNode->leaveTime + heuristicTime;
+        addVirtualNodeToOpen<B, OrderingPolicy::EXTRA_COST>(newNode);
     }
 }
 
 
-Solver::VirtualNode *Solver::step() {
+template<typename ExpansionPolicy, typename OrderingPolicy>
+template<Solver::VirtualNodeOpenList::Backend B, Solver::Heuristic H>
+Solver::VirtualNode *SolverT<ExpansionPolicy, OrderingPolicy>::stepWith() {
     if (open.empty()) {
         return nullptr;
 /*        if (extraCostFlag && maybeSuccessNode) {
@@ -356,10 +501,8 @@ Solver::VirtualNode *Solver::step() {
     }
 
     // Get a virtual node (v, h_v, v_p) off the OPEN list with the minimum h + g(v) value
-    auto it = open.begin();
-    assert(it != open.end());
-    auto vNode = removeVirtualNodeFromList(open, it, false);
-    auto &node = nodes[vNode->pos.first][vNode->pos.second];
+    auto vNode = open.pop<B>();
+    auto &node = getNode(vNode->pos);
 //    std::cerr << "pop " << vNode->pos.first << " " << vNode->pos.second << " " << vNode->estimateTime << " "
 //              << vNode->extraCost << std::endl;
 
@@ -378,59 +521,20 @@ Solver::VirtualNode *Solver::step() {
 //        return nullptr;
 //    }
 
-    // Add (v, h_v, v_p) to the CLOSED list;
-    vNode->isOpen = false;
-    addVirtualNodeToList(closed, vNode, false);
-
-
-    while (vNode->pos == scenario->getEnd(vNode->checkpoint)) {
-        // if v is the goal location v''
-        if (vNode->checkpoint == scenario->size() - 1) {
-            if (!vNode->hasChild) {
-                // we have found the solution and exit the algorithm
-                successNode = vNode;
-                /*if (extraCostFlag) {
-                    if (!maybeSuccessNode) {
-                        maybeSuccessNode = vNode;
-                    } else {
-                        assert(vNode->leaveTime <= maybeSuccessNode->leaveTime);
-                        std::cerr << vNode->extraCost << " " << maybeSuccessNode->extraCost << std::endl;
-                        if (vNode->extraCost < maybeSuccessNode->extraCost) {
-                            maybeSuccessNode = vNode;
-                        }
-                    }
-                    if (open.empty()) {
-                        successNode = maybeSuccessNode;
-                    }
-                } else {
-                    successNode = vNode;
-                }*/
-                return vNode;
-            }
-            break;
-        } else {
-            vNode->checkpoint++;
-        }
-    }
-
+    if (!closeNode(vNode, node)) return vNode;
 
-    if (algorithmId == 0) {
+    if constexpr (ExpansionPolicy::ALGORITHM_ID == 0) {
         bool waitFlag = false;
 //        bool waitFlag = true;
 
         // for each neighbouring node \bar{v} of v do
-        for (auto direction : Map::directions) {
-            auto &edge = node.edges[(size_t) direction];
-            if (!edge.available) continue; // no node
-            auto p = map->getPosByDirection(vNode->pos, direction);
-            auto &neighborNode = nodes[p.second.first][p.second.second];
+        for (const auto &item : map->getNeighbors(vNode->pos)) {
+            auto &edge = node.edges[(size_t) item.direction];
+            auto neighbor = item.id;
+            auto &neighborNode = getNode(neighbor);
 
-            size_t cv = 0;
-            if (neighborNode.occupied && !neighborNode.occupied->empty()) {
-                auto it2 = neighborNode.occupied->rbegin();
-                cv = it2->upper();
-            }
-            if (((vNode->parent && p.second != vNode->parent->pos) || !vNode->parent) && vNode->leaveTime + 1 < cv) {
+            size_t cv = neighborNode.occupied ? lastUpper(*neighborNode.occupied) : 0;
+            if (((vNode->parent && neighbor != vNode->parent->pos) || !vNode->parent) && vNode->leaveTime + 1 < cv) {
                 waitFlag = true;
             }
 
@@ -438,7 +542,7 @@ Solver::VirtualNode *Solver::step() {
 //                std::cout << p.second.first << " " << p.second.second << " " << vNode->estimateTime << std::endl;
 //            }
 
-            replaceNode(vNode, p.second, neighborNode, edge, true);
+            replaceNode<B, H>(vNode, neighbor, neighborNode, edge, true);
 //            if (logging) {
 //                std::cout << vNode->pos.first << " " << vNode->pos.second << " " << vNode->leaveTime << " -> "
 //                          << p.second.first << " " << p.second.second << " " << vNode->leaveTime + 1 << std::endl;
@@ -448,22 +552,21 @@ Solver::VirtualNode *Solver::step() {
         // if h_v + 1 not in O_v
         if (waitFlag && !isOccupied(node.occupied, vNode->leaveTime + 1)) {
             // Add (v, h_v+1, v_p) to the OPEN list;
-            auto newNode = createVirtualNode(vNode->pos, vNode->leaveTime + 1, vNode->parent, vNode->checkpoint, true);
-            addVirtualNodeToList(open, newNode, true);
+            auto newNode = createVirtualNode<OrderingPolicy::EXTRA_COST, H>(vNode->pos, vNode->leaveTime + 1, vNode->parent, vNode->checkpoint, true);
+            addVirtualNodeToOpen<B, OrderingPolicy::EXTRA_COST>(newNode);
 //            if (logging) {
 //                std::cout << vNode->pos.first << " " << vNode->pos.second << " " << vNode->leaveTime << " -> "
 //                          << vNode->pos.first << " " << vNode->pos.second << " " << vNode->leaveTime + 1 << std::endl;
 //            }
         }
 
-    } else if (algorithmId == 1) {
+    } else {
         if (!vNode->hasChild) {
-            for (auto direction : Map::directions) {
-                auto &edge = node.edges[(size_t) direction];
-                if (!edge.available) continue; // no node
-                auto p = map->getPosByDirection(vNode->pos, direction);
-                auto &neighborNode = nodes[p.second.first][p.second.second];
-                if (vNode->parent && p.second == vNode->parent->pos &&
+            for (const auto &item : map->getNeighbors(vNode->pos)) {
+                auto &edge = node.edges[(size_t) item.direction];
+                auto neighbor = item.id;
+                auto &neighborNode = getNode(neighbor);
+                if (vNode->parent && neighbor == vNode->parent->pos &&
                     vNode->checkpoint == vNode->parent->checkpoint)
                     continue; // v_n=v_p
 
@@ -476,18 +579,18 @@ Solver::VirtualNode *Solver::step() {
 //                }
 
                 if (newTime < std::numeric_limits<size_t>::max() / 2 && waitInterval.first < waitInterval.second) {
-                    auto newNode = createVirtualNode(vNode->pos, newTime, vNode->parent, vNode->checkpoint, p.second,
+                    auto newNode = createVirtualNode<OrderingPolicy::EXTRA_COST, H>(vNode->pos, newTime, vNode->parent, vNode->checkpoint, neighbor,
                                                      true);
-                    addVirtualNodeToList(open, newNode, true);
+                    addVirtualNodeToOpen<B, OrderingPolicy::EXTRA_COST>(newNode);
                 }
             }
         } else {
-            auto direction = map->getDirectionByPos(vNode->pos, vNode->child);
-            auto &edge = node.edges[(size_t) direction];
-            auto &neighborNode = nodes[vNode->child.first][vNode->child.second];
+            auto &edge = node.edges[vNode->childDirection];
+            auto child = getChild(vNode);
+            auto &neighborNode = getNode(child);
 
             if (neighborNode.occupied && !neighborNode.occupied->empty()) {
-                auto interval = boost::icl::discrete_interval<size_t>(vNode->leaveTime + 1, vNode->leaveTime + 2);
+                auto interval = Interval(vNode->leaveTime + 1, vNode->leaveTime + 2);
                 auto it2 = neighborNode.occupied->upper_bound(interval);
                 if (it2 != neighborNode.occupied->end()) {
                     auto newTime = findFirstNotOccupiedTimestamp(edge.occupied, neighborNode.occupied, it2->lower(), 1);
@@ -500,14 +603,14 @@ Solver::VirtualNode *Solver::step() {
 //                    }
 
                     if (newTime < std::numeric_limits<size_t>::max() / 2 && waitInterval.first < waitInterval.second) {
-                        auto newNode = createVirtualNode(vNode->pos, newTime, vNode->parent, vNode->checkpoint,
-                                                         vNode->child, true);
-                        addVirtualNodeToList(open, newNode, true);
+                        auto newNode = createVirtualNode<OrderingPolicy::EXTRA_COST, H>(vNode->pos, newTime, vNode->parent, vNode->checkpoint,
+                                                         child, true);
+                        addVirtualNodeToOpen<B, OrderingPolicy::EXTRA_COST>(newNode);
                     }
                 }
             }
 
-            replaceNode(vNode, vNode->child, neighborNode, edge, false);
+            replaceNode<B, H>(vNode, child, neighborNode, edge, false);
         }
     }
 
@@ -515,6 +618,47 @@ Solver::VirtualNode *Solver::step() {
     return vNode;
 }
 
+template<typename ExpansionPolicy, typename OrderingPolicy>
+template<Solver::VirtualNodeOpenList::Backend B, Solver::Heuristic H>
+Solver::SearchResult SolverT<ExpansionPolicy, OrderingPolicy>::searchWith(size_t maxStep, size_t budget) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    bool budgetUsedUp = false;
+    while (!success()) {
+        if (budget > 0 && count % BUDGET_CHECK_INTERVAL == 0 && count > 0 &&
+            (size_t) std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count() >= budget) {
+            budgetUsedUp = true;
+            break;
+        }
+        if (!stepWith<B, H>() || count >= maxStep) break;
+        ++count;
+    }
+    return getSearchResult(count, budgetUsedUp);
+}
+
+template<typename ExpansionPolicy, typename OrderingPolicy>
+Solver::VirtualNode *SolverT<ExpansionPolicy, OrderingPolicy>::step() {
+    return withSearchOptions([this](auto backend, auto heuristicOption) {
+        return stepWith<decltype(backend)::value, decltype(heuristicOption)::value>();
+    });
+}
+
+template<typename ExpansionPolicy, typename OrderingPolicy>
+Solver::SearchResult SolverT<ExpansionPolicy, OrderingPolicy>::search(size_t maxStep, size_t budget) {
+    return withSearchOptions([this, maxStep, budget](auto backend, auto heuristicOption) {
+        return searchWith<decltype(backend)::value, decltype(heuristicOption)::value>(maxStep, budget);
+    });
+}
+
+template class SolverT<SafeIntervalExpansion, PlainOrdering>;
+
+template class SolverT<SafeIntervalExpansion, ExtraCostOrdering>;
+
+template class SolverT<ChildExpansion, PlainOrdering>;
+
+template class SolverT<ChildExpansion, ExtraCostOrdering>;
+
 void Solver::addConstraints(std::vector<Solver::VirtualNode *> vector) {
     std::reverse(vector.begin(), vector.end());
     map->addNodeOccupied(vector[0]->pos, 0, vector[0]->leaveTime + 1);
@@ -522,7 +666,7 @@ void Solver::addConstraints(std::vector<Solver::VirtualNode *> vector) {
         size_t endTime = vector[j]->leaveTime + 1;
         if (j == vector.size() - 1) endTime = std::numeric_limits<size_t>::max() / 2;
         map->addNodeOccupied(vector[j]->pos, vector[j - 1]->leaveTime + 1, endTime);
-        auto dir = map->getDirectionByPos(vector[j - 1]->pos, vector[j]->pos);
+        auto dir = map->getDirectionByCell(vector[j - 1]->pos, vector[j]->pos);
         if (dir == Map::Direction::NONE) {
             throw std::runtime_error("");
         }
@@ -578,7 +722,7 @@ std::pair<size_t, size_t> Solver::getNearestParkingLocation(std::pair<size_t, si
     size_t distance = infinite;
     for (auto &p : map->getParkingLocations()) {
         auto d = map->getGraphDistance(pos, p);
-        if (d < distance && !isOccupied(nodes[p.first][p.second].occupied, infinite - 1)) {
+        if (d < distance && !isOccupied(map->getCellId(p), Map::Direction::NONE, infinite - 1, infinite)) {
             distance = d;
             result = p;
         }
@@ -15,146 +15,237 @@
 #include <memory>
 #include <limits>
 
-#include <boost/icl/discrete_interval.hpp>
-#include <boost/icl/interval_set.hpp>
+#include "IntervalSet.h"
+#include "Arena.h"
+#include "OpenList.h"
+#include "ReservationOverlay.h"
 
 
 class Solver {
 public:
+    enum class Heuristic {
+        MANHATTAN,  // manhattan distance, ignores obstacles
+        GRAPH,      // exact graph distance on the map without reservations
+        LANDMARK    // landmark lower bound of the graph distance, see Landmarks
+    };
 
+    // a virtual node is 32 bytes so that two fit in a cache line, the times are 32-bit
+    // (the deadline of a search is capped by MAX_TIME), and v_c is kept as the direction from v
     struct VirtualNode {
-        std::pair<size_t, size_t> pos;  // v
-        size_t leaveTime;               // h_v
-        size_t estimateTime;            // h_v + g(v), estimated by manhattan distance
+        Map::CellId pos;                // v
+        uint32_t leaveTime;             // h_v
+        uint32_t estimateTime;          // h_v + g(v), estimated by the heuristic
+        uint32_t extraCost;
         VirtualNode *parent;            // v_p
-        std::pair<size_t, size_t> child;// v_c
-        size_t checkpoint;
-        size_t extraCost;
-        bool hasChild;
-        bool isOpen;
+        uint16_t checkpoint;
+        uint8_t childDirection : 3;     // v_c = the neighbor of v in the direction
+        uint8_t hasChild : 1;
+        uint8_t isOpen : 1;
+        uint32_t openIndex = 0;         // position in the OPEN list, see OpenList
 
         friend std::ostream &operator<<(std::ostream &os, const VirtualNode &vNode) {
-            return os << "(" << vNode.pos.first << "," << vNode.pos.second << ") "
+            return os << "[" << vNode.pos << "] "
                       << vNode.leaveTime << " " << vNode.estimateTime << " " << vNode.extraCost;
         }
     };
 
-    struct VirtualNodeSameNodeComp {
-        bool operator()(const VirtualNode *a, const VirtualNode *b) const {
-            if (a == b) return false;
-            if (a->leaveTime != b->leaveTime) return a->leaveTime < b->leaveTime;
-            if (a->extraCost != b->extraCost) return a->extraCost < b->extraCost;
-            return a->parent < b->parent;
-        }
+    static_assert(sizeof(VirtualNode) <= 32, "a virtual node should fit in 32 bytes");
+
+    static constexpr size_t MAX_TIME = std::numeric_limits<uint32_t>::max() - 1;
+
+    // a SIPP state: the virtual nodes without a child of a cell in the same safe interval and checkpoint,
+    // the safe interval is identified by its start (NO_SAFE_INTERVAL if the node is in an occupied time),
+    // a new arrival in the state (or a state of an earlier checkpoint) is dominated by the earliest node
+    struct SafeIntervalState {
+        size_t intervalStart;
+        size_t checkpoint;
+        size_t earliestLeaveTime;
+        std::vector<VirtualNode *> vNodes;
+    };
+
+    static constexpr size_t NO_SAFE_INTERVAL = std::numeric_limits<size_t>::max();
+
+    struct StateRange {
+        SafeIntervalState *first, *last;
+
+        SafeIntervalState *begin() const { return first; };
+
+        SafeIntervalState *end() const { return last; };
     };
 
     struct Edge {
 //        std::pair<size_t, siz e_t> start, end;
-        bool available = true;
 //        std::map<size_t, size_t> *occupied = nullptr;
-        boost::icl::interval_set<size_t> *occupied = nullptr;
+        IntervalSet *occupied = nullptr;
     };
 
+    // the node grid is kept across the searches, a node of an older generation is reset when it is touched
     struct Node {
 //        std::pair<size_t, size_t> pos;
 //        std::map<size_t, size_t> *occupied = nullptr;
-        boost::icl::interval_set<size_t> *occupied = nullptr;
-        std::set<VirtualNode *, VirtualNodeSameNodeComp> virtualNodes;
+        uint32_t generation = 0;        // of the search that last touched the node
+        size_t reservationVersion = std::numeric_limits<size_t>::max();   // of the reservations when synced
+        bool overlaid = false;          // synced with the slots changed by the overlay
+        IntervalSet *occupied = nullptr;
+        // the first stateCount states are of the current search (see replaceNode), the others are kept with their
+        // vectors from the earlier searches, so that a search does not allocate them again
+        std::vector<SafeIntervalState> states;
+        size_t stateCount = 0;
         std::array<Edge, 4> edges;
+
+        StateRange getStates() { return {states.data(), states.data() + stateCount}; };
     };
 
-    // Use a multimap instead of priority_queue to support node replace
-    // key: estimateTime (ascent)
-    // value: VirtualNode *
-
-    struct VirtualNodePairComp  {
-        int extraCostId = 0;
-
-        constexpr bool operator()(const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) const {
-            if (extraCostId == 0) {
-                if (a.first == b.first) return a.second < b.second;
-                return a.first < b.first;
-            } else {
-                int diff = (int) (a.first <= b.first ? (b.first - a.first) : (a.first - b.first));
-                if (diff < extraCostId) {
-                    if (a.second == b.second) return a.first < b.first;
-                    return a.second < b.second;
-                }
-                return a.first < b.first;
-            }
-        }
+    // the OPEN list supports erasing a node to replace it, see OpenList
+    typedef OpenList<VirtualNode> VirtualNodeOpenList;
+
+    struct SearchResult {
+        enum class Status {
+            SUCCESS,        // a path is found, see constructPath
+            NO_PATH,        // the OPEN list is empty, there is no path before the deadline
+            STEP_LIMIT,     // maxStep steps are done
+            BUDGET          // the time budget is used up
+        };
+
+        Status status;
+        size_t steps;
+        size_t lowerBound;          // of the arrival time at the goal (the deadline if there is no path)
+        VirtualNode *bestNode;      // the goal or the first node in the OPEN list (a partial path), nullptr if no path
     };
 
-    typedef std::multimap<std::pair<size_t, size_t>, VirtualNode *, VirtualNodePairComp> VirtualNodeQueue;
+    // the time budget of a search is checked every BUDGET_CHECK_INTERVAL steps
+    static constexpr size_t BUDGET_CHECK_INTERVAL = 64;
 
-private:
-    VirtualNodeQueue open, closed;
+protected:
+    VirtualNodeOpenList open;
+    std::vector<VirtualNode *> closed;  // in the order of expansion, nothing is looked up in it
+    Arena<VirtualNode> virtualNodeArena;    // all virtual nodes of the current search
 
 //    std::priority_queue<VirtualNode *, std::vector<VirtualNode *>, VirtualNode> open, closed;
-    std::vector<std::vector<Node>> nodes;
+    std::vector<Node> nodes;    // indexed by cell id
+    uint32_t generation = 0;    // of the current search, the nodes of other generations are stale
+    size_t nodesTopologyVersion = 0;    // of the map when the node grid is allocated
     Map *map;
+    ReservationOverlay overlay;     // the searches see the reservations of the map through it
     const Scenario *scenario;
     VirtualNode *successNode = nullptr;
     VirtualNode *maybeSuccessNode = nullptr;
-    const int algorithmId;
     bool logging = false;
     size_t deadline;
     int extraCostId;
+    Heuristic heuristic = Heuristic::MANHATTAN;
+    std::vector<size_t> remainders;                         // heuristic from the end of each checkpoint to the goal
+    std::vector<Map::DistanceRow> checkpointRows;           // graph distances to the end of each checkpoint
+    std::vector<const uint32_t *> checkpointLandmarks;      // landmark distances of the end of each checkpoint
+    std::vector<Map::CellId> checkpointEnds;                // cell of the end of each checkpoint
 
 public:
-    static bool isOccupied(boost::icl::interval_set<size_t> *occupied, boost::icl::discrete_interval<size_t> interval);
+    static bool isOccupied(IntervalSet *occupied, Interval interval);
 
     // isOccupied in [startTime, endTime)
-    static bool isOccupied(boost::icl::interval_set<size_t> *occupied, size_t startTime, size_t endTime);
+    static bool isOccupied(IntervalSet *occupied, size_t startTime, size_t endTime);
 
     // isOccupied in [startTime, timeStart + 1)
-    static bool isOccupied(boost::icl::interval_set<size_t> *occupied, size_t timeStart);
+    static bool isOccupied(IntervalSet *occupied, size_t timeStart);
 
     std::pair<size_t, size_t>
-    findNotOccupiedInterval(boost::icl::interval_set<size_t> *occupied, size_t startTime, size_t endTime);
+    findNotOccupiedInterval(IntervalSet *occupied, size_t startTime, size_t endTime);
 
     std::pair<size_t, size_t>
-    findNotOccupiedInterval(boost::icl::interval_set<size_t> *occupied, size_t startTime);
+    findNotOccupiedInterval(IntervalSet *occupied, size_t startTime);
 
-    size_t findFirstNotOccupiedTimestamp(boost::icl::interval_set<size_t> *occupied, size_t startTime, size_t duration);
+    size_t findFirstNotOccupiedTimestamp(IntervalSet *occupied, size_t startTime, size_t duration);
 
-    size_t findFirstNotOccupiedTimestamp(boost::icl::interval_set<size_t> *occupied,
-                                         boost::icl::interval_set<size_t> *occupied2,
+    size_t findFirstNotOccupiedTimestamp(IntervalSet *occupied,
+                                         IntervalSet *occupied2,
                                          size_t startTime, size_t duration);
 
-private:
+protected:
 
 //    size_t getDistance(std::pair<size_t, size_t> start, std::pair<size_t, size_t> end);
 
-    VirtualNode *createVirtualNode(std::pair<size_t, size_t> pos, size_t leaveTime, VirtualNode *parent,
+    void initHeuristic();
+
+    // call f(backend, heuristic) with the backend of the OPEN list and the heuristic as std::integral_constant,
+    // so that the search loop is instantiated for each of them and only branches on them once per search
+    template<typename F>
+    decltype(auto) withSearchOptions(F &&f) {
+        auto withHeuristic = [this, &f](auto backend) -> decltype(auto) {
+            if (heuristic == Heuristic::GRAPH) {
+                return f(backend, std::integral_constant<Heuristic, Heuristic::GRAPH>());
+            } else if (heuristic == Heuristic::LANDMARK) {
+                return f(backend, std::integral_constant<Heuristic, Heuristic::LANDMARK>());
+            }
+            return f(backend, std::integral_constant<Heuristic, Heuristic::MANHATTAN>());
+        };
+        typedef VirtualNodeOpenList::Backend Backend;
+        if (open.getBackend() == Backend::HEAP) {
+            return withHeuristic(std::integral_constant<Backend, Backend::HEAP>());
+        } else if (open.getBackend() == Backend::BUCKET) {
+            return withHeuristic(std::integral_constant<Backend, Backend::BUCKET>());
+        }
+        return withHeuristic(std::integral_constant<Backend, Backend::MULTIMAP>());
+    };
+
+    // lower bound of the time from pos (in checkpoint) to the goal of the scenario with the heuristic H
+    template<Heuristic H>
+    size_t getHeuristic(Map::CellId pos, size_t checkpoint) const;
+
+    // the extra cost is only counted with ExtraCost (see ExtraCostOrdering)
+    template<bool ExtraCost, Heuristic H>
+    VirtualNode *createVirtualNode(Map::CellId pos, size_t leaveTime, VirtualNode *parent,
                                    size_t checkpoint, bool isOpen);
 
-    VirtualNode *createVirtualNode(std::pair<size_t, size_t> pos, size_t leaveTime, VirtualNode *parent,
-                                   size_t checkpoint, std::pair<size_t, size_t> child, bool isOpen,
+    template<bool ExtraCost, Heuristic H>
+    VirtualNode *createVirtualNode(Map::CellId pos, size_t leaveTime, VirtualNode *parent,
+                                   size_t checkpoint, Map::CellId child, bool isOpen,
                                    bool hasChild = true);
 
-    VirtualNode *removeVirtualNodeFromList(VirtualNodeQueue &list, VirtualNodeQueue::iterator it, bool editNode);
+    Map::CellId getChild(const VirtualNode *vNode) const {
+        return map->getNeighbor(vNode->pos, (Map::Direction) vNode->childDirection);
+    };
+
+    // add a node to the OPEN list (with the backend B) and its cell (dropped if it can not meet the deadline)
+    template<VirtualNodeOpenList::Backend B, bool ExtraCost>
+    void addVirtualNodeToOpen(VirtualNode *vNode);
+
+    // start of the safe interval of a node containing time, NO_SAFE_INTERVAL if it is occupied
+    size_t getSafeIntervalStart(const Node &node, size_t time);
+
+    // add a node without a child to (or remove it from) its state in the cell
+    void addToState(Node &node, VirtualNode *vNode);
 
-    void addVirtualNodeToList(VirtualNodeQueue &list, VirtualNode *vNode, bool editNode);
+    void removeFromState(Node &node, VirtualNode *vNode);
 
     void initialize();
 
     void clean();
 
-    void
-    replaceNode(VirtualNode *vNode, std::pair<size_t, size_t> pos, Node &neighborNode, Edge &edge, bool needExamine);
+    // reset a stale node (and re-sync the occupied pointers if the reservation slots or the overlay changed)
+    void resetNode(Map::CellId id, Node &node);
 
-public:
-    explicit Solver(Map *map, int algorithmId = 0, int extraCostId = 0);
+    // the result of a search ended after steps
+    SearchResult getSearchResult(size_t steps, bool budgetUsedUp);
+
+    // add a node popped from the OPEN list to the CLOSED list and move it to the checkpoint it is in,
+    // returns false if the node is the goal (successNode is set)
+    bool closeNode(VirtualNode *vNode, Node &node);
 
-    ~Solver();
+    explicit Solver(Map *map, int extraCostId = 0);
+
+public:
+    virtual ~Solver();
 
     void initScenario(const Scenario *scenario, size_t startTime = 0,
                       size_t deadline = std::numeric_limits<std::size_t>::max() / 2);
 
     bool success() { return successNode != nullptr; };
 
-    VirtualNode *step();
+    // expand the first node in the OPEN list, returns it (nullptr if the OPEN list is empty)
+    virtual VirtualNode *step() = 0;
+
+    // step until success, the OPEN list is empty, maxStep steps or budget microseconds (0: no budget)
+    virtual SearchResult search(size_t maxStep, size_t budget = 0) = 0;
 
     std::vector<VirtualNode *> constructPath(VirtualNode *vNode = nullptr);
 
@@ -164,23 +255,110 @@ public:
 
 //    void addEdgeOccupied(std::pair<size_t, size_t> pos, Direction direction, size_t startTime, size_t endTime);
 
-    bool isOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime);
+    bool isOccupied(Map::CellId pos, Map::Direction direction, size_t startTime, size_t endTime);
+
+    bool isOccupied(std::pair<size_t, size_t> pos, Map::Direction direction, size_t startTime, size_t endTime) {
+        return isOccupied(map->getCellId(pos), direction, startTime, endTime);
+    };
 
     void setLogging(bool flag) { logging = flag; };
 
+    void setHeuristic(Heuristic _heuristic) { heuristic = _heuristic; };
+
+    // only between the searches
+    void setOpenListBackend(VirtualNodeOpenList::Backend backend) {
+        open = VirtualNodeOpenList(backend, extraCostId);
+    };
+
+    auto getHeuristic() const { return this->heuristic; };
+
     auto getMap() const { return this->map; };
 
+    // the changes to the reservations of the map seen by the following searches (empty if there are none),
+    // it must not be changed during a search, see ReservationOverlay
+    ReservationOverlay &getOverlay() { return this->overlay; };
+
     auto getScenario() const { return this->scenario; };
 
-    auto &getNodes() const { return this->nodes; };
+    // the node of a cell in the current search
+    Node &getNode(Map::CellId id) {
+        auto &node = nodes[id];
+        if (node.generation != generation) resetNode(id, node);
+        return node;
+    };
+
+    Node &getNode(std::pair<size_t, size_t> pos) { return getNode(map->getCellId(pos)); };
+
+    auto &getAllocationStats() const { return this->virtualNodeArena.getStats(); };
+
+    // the virtual nodes created by all searches and the arena slabs allocated for them, the other containers of the
+    // searches (the OPEN and CLOSED lists, the states of the node grid) allocate on the heap separately
+    void printAllocationStats() const;
 
     auto &getOpen() const { return this->open; };
 
     auto &getClosed() const { return this->closed; };
 
+    // the nodes in the OPEN or the CLOSED list in the order of the OPEN list, for debugging and the UI
+    std::vector<VirtualNode *> getSortedOpen() const;
+
+    std::vector<VirtualNode *> getSortedClosed() const;
+
     std::pair<size_t, size_t> getNearestParkingLocation(std::pair<size_t, size_t> pos);
 
 };
 
+// the expansion policies of SolverT
+struct SafeIntervalExpansion {     // algorithm 0: move to the neighbors or wait for one time step
+    static constexpr int ALGORITHM_ID = 0;
+};
+
+struct ChildExpansion {            // algorithm 1 (deprecated): wait in a node until moving to its child
+    static constexpr int ALGORITHM_ID = 1;
+};
+
+// the ordering policies of SolverT
+struct PlainOrdering {             // by the estimated time
+    static constexpr bool EXTRA_COST = false;
+};
+
+struct ExtraCostOrdering {         // by the estimated time and the extra cost in a window (-ec)
+    static constexpr bool EXTRA_COST = true;
+};
+
+// the search with the policies fixed at compile time, instantiated for all policies in Solver.cpp,
+// use Manager::createSolver to select one at runtime
+// the backend of the OPEN list and the heuristic can be changed between the searches, search and step select
+// the loop instantiated for them once (see withSearchOptions)
+template<typename ExpansionPolicy, typename OrderingPolicy>
+class SolverT : public Solver {
+private:
+    typedef VirtualNodeOpenList::Backend Backend;
+
+    template<Backend B, Heuristic H>
+    void replaceNode(VirtualNode *vNode, Map::CellId pos, Node &neighborNode, Edge &edge, bool needExamine);
+
+    template<Backend B, Heuristic H>
+    VirtualNode *stepWith();
+
+    template<Backend B, Heuristic H>
+    SearchResult searchWith(size_t maxStep, size_t budget);
+
+public:
+    explicit SolverT(Map *map, int extraCostId = 0) : Solver(map, extraCostId) {}
+
+    VirtualNode *step() override;
+
+    SearchResult search(size_t maxStep, size_t budget) override;
+};
+
+extern template class SolverT<SafeIntervalExpansion, PlainOrdering>;
+
+extern template class SolverT<SafeIntervalExpansion, ExtraCostOrdering>;
+
+extern template class SolverT<ChildExpansion, PlainOrdering>;
+
+extern template class SolverT<ChildExpansion, ExtraCostOrdering>;
+
 
 #endif //MAPF_SOLVER_H
@@ -0,0 +1,116 @@
+#include "ThreadPool.h"
+
+static thread_local const ThreadPool *currentPool = nullptr;
+static thread_local size_t currentIndex = 0;
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    // one extra queue for the tasks submitted from outside of the pool
+    for (size_t i = 0; i <= threads; i++) {
+        queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskCondition.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::getWorkerIndex() const {
+    if (currentPool == this) return currentIndex;
+    return threads.size();
+}
+
+void ThreadPool::submit(TaskFunction task) {
+    size_t index = getWorkerIndex();
+    if (index == threads.size()) {
+        index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    }
+    pending.fetch_add(1);
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.emplace_back(std::move(task));
+    }
+    {
+        // take the lock so that a worker can not miss the notification between its check and wait
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    taskCondition.notify_one();
+}
+
+bool ThreadPool::popTask(size_t index, TaskFunction &task) {
+    // pop from the back of the own queue
+    {
+        auto &queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    // steal from the front of the other queues
+    for (size_t i = 1; i < queues.size(); i++) {
+        auto &queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTask(TaskFunction &task) {
+    task();
+    task = nullptr;
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        doneCondition.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentIndex = index;
+    TaskFunction task;
+    while (true) {
+        if (popTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        taskCondition.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
+
+void ThreadPool::wait() {
+    size_t index = getWorkerIndex();
+    if (index == threads.size()) index = queues.size() - 1;
+    TaskFunction task;
+    while (pending.load() > 0) {
+        if (popTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this]() { return pending.load() == 0 || queued.load() > 0; });
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef MAPF_THREADPOOL_H
+#define MAPF_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+// A work-stealing thread pool
+// every worker owns a deque, pops its own tasks from the back and steals from the front of others,
+// the thread calling wait() also helps to run the remaining tasks
+class ThreadPool {
+public:
+    typedef std::function<void()> TaskFunction;
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<TaskFunction> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue> > queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable taskCondition;
+    std::condition_variable doneCondition;
+    std::atomic<size_t> pending{0};   // submitted but not finished
+    std::atomic<size_t> queued{0};    // submitted but not started
+    std::atomic<size_t> nextQueue{0};
+    bool stopping = false;
+
+    void workerLoop(size_t index);
+
+    bool popTask(size_t index, TaskFunction &task);
+
+    void runTask(TaskFunction &task);
+
+public:
+    // threads = 0 means use all hardware threads
+    explicit ThreadPool(size_t threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    auto size() const { return this->threads.size(); };
+
+    // index of the current worker in [0, size()), size() for threads outside of the pool
+    size_t getWorkerIndex() const;
+
+    void submit(TaskFunction task);
+
+    // block until all submitted tasks are finished, must not be called inside a task
+    void wait();
+
+    // run f(i) for i in [begin, end), split into chunks of grain indices
+    template<typename F>
+    void parallelFor(size_t begin, size_t end, size_t grain, F &&f) {
+        if (grain == 0) grain = 1;
+        for (size_t i = begin; i < end; i += grain) {
+            size_t chunkEnd = std::min(end, i + grain);
+            submit([i, chunkEnd, &f]() {
+                for (size_t k = i; k < chunkEnd; k++) f(k);
+            });
+        }
+        wait();
+    }
+};
+
+
+#endif //MAPF_THREADPOOL_H
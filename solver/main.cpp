@@ -82,6 +82,14 @@ int main(int argc, const char *argv[]) {
     auto validMaxStep = new ez::ezOptionValidator("u4");
     optionParser.add("100000", false, 1, 0, "Max Step", "--max-step", validMaxStep);
 
+    auto validBudget = new ez::ezOptionValidator("u4", "ge", "0");
+    optionParser.add("0", false, 1, 0, "Time budget of each flex computation in microseconds (0 means no limit)",
+                     "--budget", validBudget);
+
+    auto validFlexThreads = new ez::ezOptionValidator("u4", "ge", "0");
+    optionParser.add("1", false, 1, 0, "Threads of the flex computation (0 means all hardware threads)",
+                     "--flex-threads", validFlexThreads);
+
     auto validWindowSize = new ez::ezOptionValidator("u4", "ge", "0");
     optionParser.add("0", false, 1, 0, "Window Size (0 means no limit)", "-w", "--window", validWindowSize);
 
@@ -95,6 +103,19 @@ int main(int argc, const char *argv[]) {
     optionParser.add("", false, 0, 0, "Skip no conflict", "-skip", "--skip-no-conflict");
     optionParser.add("", false, 0, 0, "Reserve nearest", "-rn", "--reserve-nearest");
     optionParser.add("", false, 0, 0, "Reserve nearest", "--retry");
+    optionParser.add("manhattan", false, 1, 0, "Heuristic (manhattan/graph/landmark)", "--heuristic");
+    auto validLandmarks = new ez::ezOptionValidator("u4", "gt", "0");
+    optionParser.add("16", false, 1, 0, "Number of landmarks (landmark heuristic)", "--landmarks", validLandmarks);
+    optionParser.add("table", false, 1, 0, "Distance mode (table/lazy)", "--distance-mode");
+    auto validDistanceCache = new ez::ezOptionValidator("u4", "gt", "0");
+    optionParser.add("1024", false, 1, 0, "Distance cache size in MB (lazy mode)", "--distance-cache",
+                     validDistanceCache);
+    optionParser.add("dense", false, 1, 0, "Reservation table (dense/sparse)", "--reservation");
+    optionParser.add("multimap", false, 1, 0, "OPEN list (multimap/heap/bucket)", "--open-list");
+    optionParser.add("", false, 1, 0, "Dump the reservations at the end to a file", "--dump-reservations");
+    auto validCollect = new ez::ezOptionValidator("u4", "ge", "0");
+    optionParser.add("0", false, 1, 0, "Collect expired reservations every N tasks (0 to disable)", "--gc",
+                     validCollect);
     optionParser.parse(argc, argv);
 
     if (optionParser.isSet("-h")) {
@@ -104,12 +125,14 @@ int main(int argc, const char *argv[]) {
         return 1;
     }
 
-    std::string dataPath, taskFile, outputFile, scheduler;
+    std::string dataPath, taskFile, outputFile, scheduler, distanceMode, heuristic, reservation, reservationFile,
+            openList;
     double phi;
     int algorithmId, extraCostId;
     bool boundFlag, sortFlag, multiLabelFlag, deadlineBoundFlag, taskBoundFlag, recalculateFlag,
             reserveAllFlag, skipFlag, reserveNearestFlag, retryFlag;
-    unsigned long long maxStep, windowSize;
+    unsigned long long maxStep, windowSize, distanceCacheSize, landmarkCount, collectInterval, budget,
+            flexThreads;
 
     optionParser.get("--data")->getString(dataPath);
     optionParser.get("--task")->getString(taskFile);
@@ -119,7 +142,17 @@ int main(int argc, const char *argv[]) {
     optionParser.get("--algorithm")->getInt(algorithmId);
     optionParser.get("--extra-cost")->getInt(extraCostId);
     optionParser.get("--max-step")->getULongLong(maxStep);
+    optionParser.get("--budget")->getULongLong(budget);
+    optionParser.get("--flex-threads")->getULongLong(flexThreads);
     optionParser.get("--window")->getULongLong(windowSize);
+    optionParser.get("--heuristic")->getString(heuristic);
+    optionParser.get("--landmarks")->getULongLong(landmarkCount);
+    optionParser.get("--distance-mode")->getString(distanceMode);
+    optionParser.get("--distance-cache")->getULongLong(distanceCacheSize);
+    optionParser.get("--reservation")->getString(reservation);
+    optionParser.get("--open-list")->getString(openList);
+    optionParser.get("--dump-reservations")->getString(reservationFile);
+    optionParser.get("--gc")->getULongLong(collectInterval);
     boundFlag = optionParser.isSet("--bound");
     sortFlag = optionParser.isSet("--sort");
     multiLabelFlag = optionParser.isSet("--mlabel");
@@ -152,6 +185,37 @@ int main(int argc, const char *argv[]) {
             recalculateFlag, reserveAllFlag,
             skipFlag, reserveNearestFlag, retryFlag
     );
+    if (distanceMode == "lazy") {
+        manager.setDistanceMode(Map::DistanceMode::LAZY, distanceCacheSize * 1024 * 1024);
+    } else if (distanceMode != "table") {
+        std::cerr << "unknown distance mode: " << distanceMode << std::endl;
+        return 1;
+    }
+    if (reservation == "sparse") {
+        manager.setReservationBackend(ReservationTable::Backend::SPARSE);
+    } else if (reservation != "dense") {
+        std::cerr << "unknown reservation table: " << reservation << std::endl;
+        return 1;
+    }
+    if (openList == "heap") {
+        manager.setOpenListBackend(Solver::VirtualNodeOpenList::Backend::HEAP);
+    } else if (openList == "bucket") {
+        manager.setOpenListBackend(Solver::VirtualNodeOpenList::Backend::BUCKET);
+    } else if (openList != "multimap") {
+        std::cerr << "unknown open list: " << openList << std::endl;
+        return 1;
+    }
+    manager.setCollectInterval(collectInterval);
+    manager.setFlexBudget(budget);
+    manager.setFlexThreads(flexThreads);
+    if (heuristic == "graph") {
+        manager.setHeuristic(Solver::Heuristic::GRAPH);
+    } else if (heuristic == "landmark") {
+        manager.setHeuristic(Solver::Heuristic::LANDMARK, landmarkCount);
+    } else if (heuristic != "manhattan") {
+        std::cerr << "unknown heuristic: " << heuristic << std::endl;
+        return 1;
+    }
     auto map = manager.loadTaskFile(taskFile);
 
     if (scheduler == "edf") {
@@ -162,7 +226,13 @@ int main(int argc, const char *argv[]) {
         assert(0);
     }
 
-    manager.printPaths();
+    manager.printPaths(map);
+    map->printDistanceStats();
+
+    if (!reservationFile.empty()) {
+        std::ofstream reservationOut(reservationFile);
+        reservationOut << map->printOccupiedMap();
+    }
 
     if (!outputFile.empty()) {
         std::cout.rdbuf(coutBuf);
@@ -190,29 +190,33 @@ void GraphWidget::clearSelected() {
 void GraphWidget::updateOccupiedList(std::map<size_t, size_t> *occupied, bool all) {
     occupiedListWidget->clear();
     if (all) {
-        for (const auto &it : solver->getMap()->getOccupiedMap()) {
+        auto map = solver->getMap();
+        map->getReservations().forEach([&](size_t id, ReservationTable::SlotType type,
+                                           const ReservationTable::Slot &slot) {
             QString header;
-            auto node = nodes[it.first.pos.first][it.first.pos.second];
-            if (it.first.direction == Map::Direction::NONE) {
+            auto pos = map->getPos(id);
+            auto node = nodes[pos.first][pos.second];
+            if (type == ReservationTable::SlotType::VERTEX) {
                 if (node->isBlocked()) {
-                    continue;
+                    return;
                 }
                 header = node->toString();
             } else {
-                auto edge = node->getEdge((int) it.first.direction);
+                auto direction = type == ReservationTable::SlotType::RIGHT ? Map::Direction::RIGHT : Map::Direction::DOWN;
+                auto edge = node->getEdge((int) direction);
                 if (edge == nullptr || edge->sourceNode()->isBlocked() || edge->destNode()->isBlocked()) {
-                    continue;
+                    return;
                 }
                 header = edge->toString();
             }
-            for (const auto &p : *it.second) {
-                QString text = "[" + QString::number(p.first) + ", " + QString::number(p.second) + ")";
+            for (const auto &interval : slot.rangeConstraints) {
+                QString text = "[" + QString::number(interval.lower()) + ", " + QString::number(interval.upper()) + ")";
                 auto item = new QListWidgetItem(header + " " + text, occupiedListWidget);
-                if (p.first <= timestamp && p.second > timestamp) {
+                if (interval.lower() <= timestamp && interval.upper() > timestamp) {
                     item->setForeground(Qt::red);
                 }
             }
-        }
+        });
     } else if (occupied) {
         for (const auto &p : *occupied) {
             QString text = "[" + QString::number(p.first) + ", " + QString::number(p.second) + ")";
@@ -228,9 +232,12 @@ void GraphWidget::updateOccupiedList(std::map<size_t, size_t> *occupied, bool al
 
 
 void GraphWidget::addToOpenClosedList(const Solver::VirtualNode *vNode) {
-    QString text = nodes[vNode->pos.first][vNode->pos.second]->toString();
+    auto map = solver->getMap();
+    auto pos = map->getPos(vNode->pos);
+    QString text = nodes[pos.first][pos.second]->toString();
     if (vNode->parent) {
-        text += " -> " + nodes[vNode->parent->pos.first][vNode->parent->pos.second]->toString();
+        auto parentPos = map->getPos(vNode->parent->pos);
+        text += " -> " + nodes[parentPos.first][parentPos.second]->toString();
     } else {
         text += " -> <null>";
     }
@@ -245,15 +252,15 @@ void GraphWidget::addToOpenClosedList(const Solver::VirtualNode *vNode) {
     }
 }
 
-void GraphWidget::updateOpenClosedList(const std::multimap<size_t, Solver::VirtualNode *> &open,
-                                       const std::multimap<size_t, Solver::VirtualNode *> &closed) {
+void GraphWidget::updateOpenClosedList(const std::vector<Solver::VirtualNode *> &open,
+                                       const std::vector<Solver::VirtualNode *> &closed) {
     openListWidget->clear();
     closedListWidget->clear();
-    for (auto &p : open) {
-        addToOpenClosedList(p.second);
+    for (auto vNode : open) {
+        addToOpenClosedList(vNode);
     }
-    for (auto &p : closed) {
-        addToOpenClosedList(p.second);
+    for (auto vNode : closed) {
+        addToOpenClosedList(vNode);
     }
     if (openListWidget->children().count() == 0) {
         new QListWidgetItem("<null>", openListWidget);
@@ -263,11 +270,13 @@ void GraphWidget::updateOpenClosedList(const std::multimap<size_t, Solver::Virtu
     }
 }
 
-void GraphWidget::updateOpenClosedList(const std::set<Solver::VirtualNode *, Solver::VirtualNodeSameNodeComp> &vNodes) {
+void GraphWidget::updateOpenClosedList(Solver::StateRange states) {
     openListWidget->clear();
     closedListWidget->clear();
-    for (auto &vNode : vNodes) {
-        addToOpenClosedList(vNode);
+    for (auto &state : states) {
+        for (auto vNode : state.vNodes) {
+            addToOpenClosedList(vNode);
+        }
     }
     if (openListWidget->children().count() == 0) {
         new QListWidgetItem("<null>", openListWidget);
@@ -280,23 +289,23 @@ void GraphWidget::updateOpenClosedList(const std::set<Solver::VirtualNode *, Sol
 void GraphWidget::updateLists() {
     if (selectedNode) {
         auto pos = selectedNode->getPos();
-        auto &node = solver->getNodes()[pos.first][pos.second];
+        auto &node = solver->getNode(pos);
         updateOccupiedList(node.occupied);
-        updateOpenClosedList(node.virtualNodes);
+        updateOpenClosedList(node.getStates());
         occupiedListLabel->setText("Ov " + selectedNode->toString());
         openListLabel->setText("Node Open List " + selectedNode->toString());
         closedListLabel->setText("Node Closed List " + selectedNode->toString());
     } else if (selectedEdge) {
         auto pos = selectedEdge->sourceNode()->getPos();
-        auto &node = solver->getNodes()[pos.first][pos.second];
+        auto &node = solver->getNode(pos);
         updateOccupiedList(node.edges[selectedEdge->getDirection()].occupied);
-        updateOpenClosedList(solver->getOpen(), solver->getClosed());
+        updateOpenClosedList(solver->getSortedOpen(), solver->getSortedClosed());
         occupiedListLabel->setText("Oe " + selectedEdge->toString());
         openListLabel->setText("Global Open List");
         closedListLabel->setText("Global Closed List");
     } else {
         updateOccupiedList(nullptr, true);
-        updateOpenClosedList(solver->getOpen(), solver->getClosed());
+        updateOpenClosedList(solver->getSortedOpen(), solver->getSortedClosed());
         occupiedListLabel->setText("");
         openListLabel->setText("Global Open List");
         closedListLabel->setText("Global Closed List");
@@ -342,7 +351,8 @@ void GraphWidget::updateLabel() {
     string += "Timestamp (h_v): " + QString::number(timestamp);
     string += "\nStep: " + QString::number(step);
     if (!savedPath.empty()) {
-        string += "\nLast VNode: " + nodes[latestVNode.pos.first][latestVNode.pos.second]->toString()
+        auto pos = solver->getMap()->getPos(latestVNode.pos);
+        string += "\nLast VNode: " + nodes[pos.first][pos.second]->toString()
                   + ")\nh_v + g(v) = " + QString::number(latestVNode.estimateTime);
     } else {
         string += "\n\n";
@@ -357,11 +367,10 @@ void GraphWidget::setTimeStamp(size_t timestamp) {
     this->timestamp = timestamp;
     auto map = solver->getMap();
     auto height = map->getHeight(), width = map->getWidth();
-    auto &solverNodes = solver->getNodes();
 
     for (int i = 0; i < height; i++) {
         for (int j = 0; j < width; j++) {
-            auto &solverNode = solverNodes[i][j];
+            auto &solverNode = solver->getNode({size_t(i), size_t(j)});
             nodes[i][j]->setOccupied(solver->isOccupied(solverNode.occupied, timestamp));
             for (int k = 0; k < 4; k++) {
                 auto edge = nodes[i][j]->getEdge(k);
@@ -425,10 +434,10 @@ void GraphWidget::handleStepButton() {
     auto newPath = solver->constructPath(vNode);
     if (!newPath.empty()) {
         for (int i = 0; i < newPath.size(); i++) {
-            auto p1 = newPath[i]->pos;
+            auto p1 = solver->getMap()->getPos(newPath[i]->pos);
             int direction = -1;
             if (i < newPath.size() - 1) {
-                auto p2 = newPath[i + 1]->pos;
+                auto p2 = solver->getMap()->getPos(newPath[i + 1]->pos);
                 for (int j = 0; j < 4; j++) {
                     if (int(p2.first) - int(p1.first) == DIRECTION_X[j] &&
                         int(p2.second) - int(p1.second) == DIRECTION_Y[j]) {
@@ -70,10 +70,10 @@ private:
 
     void addToOpenClosedList(const Solver::VirtualNode *vNode);
 
-    void updateOpenClosedList(const std::multimap<size_t, Solver::VirtualNode *> &open,
-                              const std::multimap<size_t, Solver::VirtualNode *> &closed);
+    void updateOpenClosedList(const std::vector<Solver::VirtualNode *> &open,
+                              const std::vector<Solver::VirtualNode *> &closed);
 
-    void updateOpenClosedList(const std::set<Solver::VirtualNode *, Solver::VirtualNodeSameNodeComp> &vNodes);
+    void updateOpenClosedList(Solver::StateRange states);
 
     void updateLists();
 
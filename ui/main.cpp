@@ -24,7 +24,7 @@ int main(int argc, char **argv) {
 
     auto scenario = manager.getScenario(0);
     auto map = scenario->getMap();
-    Solver solver(map);
+    SolverT<SafeIntervalExpansion, PlainOrdering> solver(map);
 
 //   map->addNodeOccupied({0, 1}, 0, 3);
 //   map->addNodeOccupied({0, 2}, 4, 5);